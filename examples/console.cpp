@@ -0,0 +1,23 @@
+#include <vdp_console.h>
+
+static VdpConsole con;
+
+void console()
+{
+    if (vdp_init_g2())
+        Serial.println("VDP Error");
+    con.begin(VDP_WHITE, VDP_DARK_BLUE);
+    vdp_set_bdcolor(VDP_DARK_BLUE);
+
+    static const uint8_t colors[] = {VDP_LIGHT_YELLOW, VDP_CYAN, VDP_LIGHT_GREEN, VDP_LIGHT_RED};
+    for (uint16_t line = 0;; line++)
+    {
+        con.set_color(VDP_WHITE, VDP_DARK_BLUE);
+        con.print("Line ");
+        con.set_color(colors[line & 3], VDP_DARK_BLUE);
+        con.print(line);
+        con.set_color(VDP_WHITE, VDP_DARK_BLUE);
+        con.println(line % 5 ? " scrolls up" : " is longer than a row of the screen and wraps");
+        delay(100);
+    }
+}
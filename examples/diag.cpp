@@ -0,0 +1,45 @@
+#include <tms9918.h>
+#include <vdp_diag.h>
+
+// Results of the diagnostics, on the screen and over Serial
+static void report(Print &out, int ram, const VdpMarchResult &fault, int bus, const VdpTiming &timing)
+{
+    out.print("VRAM March C-: ");
+    if (ram == VDP_OK)
+        out.println("passed");
+    else
+    {
+        out.print("failed at 0x");
+        out.print(fault.address, HEX);
+        out.print(" bits 0x");
+        out.println(fault.expected ^ fault.actual, HEX);
+    }
+    out.println("Bus timing in delay loops of 3 cycles:");
+    if (bus != VDP_OK)
+    {
+        out.println("No working timing found");
+        return;
+    }
+    out.print(" CSW strobe ");
+    out.println(timing.strobe_write);
+    out.print(" CSR strobe ");
+    out.println(timing.strobe_read);
+    out.print(" Gap, display off ");
+    out.println(timing.gap_blank);
+    out.print(" Gap, display on ");
+    out.println(timing.gap_active);
+}
+
+void diag()
+{
+    Serial.begin(9600);
+    vdp_init_textmode(VDP_WHITE, VDP_DARK_BLUE);
+    VdpMarchResult fault;
+    VdpTiming timing;
+    int ram = vdp_diag_march(&fault);
+    int bus = vdp_diag_timing(timing);
+
+    vdp_init_textmode(VDP_WHITE, VDP_DARK_BLUE);
+    report(vdp_text, ram, fault, bus, timing);
+    report(Serial, ram, fault, bus, timing);
+}
@@ -6,5 +6,7 @@ void g1text();
 void g2text();
 void sprites();
 void g2image();
+void console();
+void diag();
 
 #endif
\ No newline at end of file
@@ -9,6 +9,8 @@ void setup()
     //g2text();
     //sprites();
     //g2image();
+    //console();
+    //diag();
 }
 
 void loop()
@@ -1,42 +1,138 @@
 #include <tms9918.h>
+#include <vdp_image.h>
+#include <tmslink.h>
 
 bool loaded = false;
 
+#if defined(SERIAL_RX_BUFFER_SIZE) && SERIAL_RX_BUFFER_SIZE <= TMS_LINK_CREDIT
+#error "The serial receive buffer is too small for TMS_LINK_CREDIT"
+#endif
+
+// Waits for the start of the next frame
+bool syncFrame()
+{
+    uint8_t c;
+    do
+    {
+        if (Serial.readBytes(&c, 1) != 1)
+            return false;
+    } while (c != TMS_LINK_SOF);
+    return true;
+}
+
+// Reads a frame after its start byte. Returns false if it is damaged
+bool readFrame(uint8_t *frame)
+{
+    return Serial.readBytes(frame, 2) == 2 && frame[1] <= TMS_LINK_PAYLOAD &&
+           Serial.readBytes(frame + 2, frame[1] + 2) == frame[1] + 2u && tms_link_check(frame);
+}
+
+void reply(uint8_t type, uint8_t seq)
+{
+    uint8_t r[2] = {type, seq};
+    Serial.write(r, 2);
+}
+
+uint8_t link_frame[TMS_LINK_FRAME - 1];
+uint8_t link_expected; // Sequence number of the next frame
+bool link_sync;        // Start byte of the next frame still to read
+
+// Returns the payload of the next frame of the serial link (see tmslink.h), NULL if the sender is gone
+uint8_t *linkRead(uint8_t &len)
+{
+    uint8_t timeouts = 0;
+    for (;;)
+    {
+        if (link_sync && !syncFrame())
+        {
+            if (++timeouts > TMS_LINK_RETRIES)
+                return NULL;
+            reply(TMS_LINK_NAK, link_expected); // The frame or the reply got lost, ask again
+            continue;
+        }
+        link_sync = true;
+        bool ok = readFrame(link_frame);
+        if (!ok || link_frame[0] != link_expected)
+        {
+            if (ok && (uint8_t)(link_expected - link_frame[0]) < 128)
+                reply(TMS_LINK_ACK, link_expected); // Repeated frame, the ACK got lost
+            else
+                reply(TMS_LINK_NAK, link_expected);
+            continue;
+        }
+        reply(TMS_LINK_ACK, ++link_expected); // Before the frame is processed, the next ones are on the way
+        len = link_frame[1];
+        return link_frame + 2;
+    }
+}
+
+// Image in TMS format or stream of frames (see tmsimage.h), sent by imgserial over the serial link.
+// The first frame holds the header.
+void loadTms()
+{
+    uint8_t len, *data;
+    link_expected = 0;
+    link_sync = false; // The start byte has been read by serialEvent()
+    if (!(data = linkRead(len)))
+        return;
+    if (len == TMS_IMAGE_HEADER_SIZE && tms_stream_check(data))
+    {
+        VdpStreamPlayer player;
+        vdp_init_g2();
+        vdp_set_bdcolor(VDP_BLACK);
+        player.begin();
+        while ((data = linkRead(len)) && player.write(data, len))
+            ;
+        return;
+    }
+    VdpTmsLoader loader;
+    if (len != TMS_IMAGE_HEADER_SIZE || !loader.begin(data))
+    {
+        vdp_print("Unknown format");
+        return;
+    }
+    vdp_init_g2();
+    vdp_set_bdcolor(VDP_BLACK);
+    uint16_t left = loader.data_size();
+    while (left && (data = linkRead(len)))
+    {
+        if (len > left) // More than the header announced
+            len = left;
+        loader.write(data, len);
+        left -= len;
+    }
+}
+
+bool readRow(uint8_t *row, uint8_t y)
+{
+    if (y > 0)
+        Serial.write('@'); // Previous row processed
+    return Serial.readBytes(row, 256) == 256;
+}
+
 void serialEvent()
 {
     uint16_t y = 0, n_cols, n_lines;
-    uint8_t line[256];
     delay(10);
     n_cols = Serial.read();
+    if (n_cols == TMS_LINK_SOF)
+    {
+        loadTms();
+        return;
+    }
     n_lines = Serial.read();
     n_cols == 0 ? n_cols = 256 : n_cols;
     if (n_cols == 256) //Hi-res
     {
         vdp_init_g2();
         vdp_set_bdcolor(VDP_BLACK);
-        while (y < 192)
-        {
-            Serial.readBytes(line, 256);
-            uint8_t color1 = 0, color2 = 0;
-            for (int x = 0; x < n_cols; x++)
-            {
-                if(x%8 == 0)
-                    color1 = color2 = line[x];
-                else if(line[x] != color1)
-                    color2 = line[x];
-
-                if(line[x] == color1)    
-                    vdp_plot_hires(x, y, color1+1);
-                else
-                    vdp_plot_hires(x, y, NULL, color2+1);
-            }
-            y++;
-            Serial.write('@');
-        }
+        vdp_load_g2_bitmap(readRow, 1); // Gimp palette index 0 is black
+        Serial.write('@');
         //sprites();
     } 
     else if(n_cols == 64)
     {
+        uint8_t line[64];
         vdp_init_multicolor();
         while (y < 64)
         {
@@ -0,0 +1,621 @@
+/* Conversion of PNG and PPM images into TMS images for the imgserial tool
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <cstring>
+#include <cctype>
+#include <cstdlib>
+#include <stdexcept>
+#include <atomic>
+#include <thread>
+#include "imgconvert.h"
+#include "../../src/tmsimage.h"
+
+using namespace std;
+
+// Colors 1-15 of the TMS9918 as in tms9918.gpl. Color 0 is transparent
+static const uint8_t palette[16][3] = {
+    {0, 0, 0}, {0, 0, 0}, {33, 200, 66}, {94, 220, 120}, {84, 85, 237}, {125, 118, 252}, {212, 82, 77}, {66, 235, 245},
+    {252, 85, 84}, {255, 121, 120}, {212, 193, 84}, {230, 206, 128}, {33, 176, 59}, {201, 91, 186}, {204, 204, 204}, {255, 255, 255}};
+#define N_COLORS 15
+
+static vector<uint8_t> read_file(const char *fname)
+{
+    FILE *f = fopen(fname, "rb");
+    if (!f)
+        throw runtime_error(string("Error opening file: ") + strerror(errno));
+    vector<uint8_t> data;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+        data.insert(data.end(), buf, buf + n);
+    fclose(f);
+    return data;
+}
+
+/********************************* PPM *********************************/
+static int ppm_number(const vector<uint8_t> &data, size_t &pos)
+{
+    while (pos < data.size() && (isspace(data[pos]) || data[pos] == '#'))
+        if (data[pos++] == '#')
+            while (pos < data.size() && data[pos] != '\n')
+                pos++;
+    if (pos >= data.size() || !isdigit(data[pos]))
+        throw runtime_error("Invalid PPM file");
+    int n = 0;
+    while (pos < data.size() && isdigit(data[pos]))
+        n = n * 10 + data[pos++] - '0';
+    return n;
+}
+
+// P2, P3: ASCII gray and RGB, P5, P6: binary gray and RGB
+static void load_ppm(const vector<uint8_t> &data, RgbImage &image)
+{
+    size_t pos = 2;
+    char type = data[1];
+    int channels = (type == '3' || type == '6') ? 3 : 1;
+    image.width = ppm_number(data, pos);
+    image.height = ppm_number(data, pos);
+    int maxval = ppm_number(data, pos);
+    if (image.width <= 0 || image.height <= 0 || maxval <= 0 || maxval > 65535)
+        throw runtime_error("Invalid PPM file");
+    pos++; // Single whitespace after the header
+    size_t n = (size_t)image.width * image.height * channels;
+    int bytes = maxval > 255 ? 2 : 1;
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    for (size_t i = 0; i < n; i++)
+    {
+        int v;
+        if (type == '2' || type == '3')
+            v = ppm_number(data, pos);
+        else
+        {
+            if (pos + bytes > data.size())
+                throw runtime_error("PPM file too short");
+            v = bytes == 2 ? data[pos] << 8 | data[pos + 1] : data[pos];
+            pos += bytes;
+        }
+        uint8_t c = v * 255 / maxval;
+        if (channels == 3)
+            image.pixels[i] = c;
+        else
+            memset(&image.pixels[i * 3], c, 3);
+    }
+}
+
+/********************************* PNG *********************************/
+// Decoder for the deflate streams in PNG files (RFC 1951), after zlib's puff.c
+class Inflate
+{
+public:
+    Inflate(const uint8_t *data, size_t len) : in(data), in_len(len) {}
+    vector<uint8_t> out;
+
+    void run()
+    {
+        int last;
+        do
+        {
+            last = bits(1);
+            switch (bits(2))
+            {
+            case 0:
+                stored();
+                break;
+            case 1:
+                fixed();
+                break;
+            case 2:
+                dynamic();
+                break;
+            default:
+                throw runtime_error("Invalid deflate block");
+            }
+        } while (!last);
+    }
+
+private:
+    struct Huffman
+    {
+        uint16_t count[16];  // Number of codes of each length
+        uint16_t symbol[288]; // Symbols ordered by code
+    };
+    const uint8_t *in;
+    size_t in_len, pos = 0;
+    uint32_t bitbuf = 0;
+    int bitcnt = 0;
+
+    int bits(int n)
+    {
+        while (bitcnt < n)
+        {
+            if (pos >= in_len)
+                throw runtime_error("Unexpected end of PNG data");
+            bitbuf |= (uint32_t)in[pos++] << bitcnt;
+            bitcnt += 8;
+        }
+        int v = bitbuf & ((1 << n) - 1);
+        bitbuf >>= n;
+        bitcnt -= n;
+        return v;
+    }
+
+    static void build(Huffman &h, const uint8_t *length, int n)
+    {
+        uint16_t offs[16];
+        memset(h.count, 0, sizeof(h.count));
+        for (int i = 0; i < n; i++)
+            h.count[length[i]]++;
+        h.count[0] = 0;
+        offs[1] = 0;
+        for (int len = 1; len < 15; len++)
+            offs[len + 1] = offs[len] + h.count[len];
+        for (int i = 0; i < n; i++)
+            if (length[i])
+                h.symbol[offs[length[i]]++] = i;
+    }
+
+    int decode(const Huffman &h)
+    {
+        int code = 0, first = 0, index = 0;
+        for (int len = 1; len < 16; len++)
+        {
+            code |= bits(1);
+            int count = h.count[len];
+            if (code - count < first)
+                return h.symbol[index + code - first];
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        throw runtime_error("Invalid huffman code");
+    }
+
+    void stored()
+    {
+        bitbuf = 0;
+        bitcnt = 0;
+        if (pos + 4 > in_len)
+            throw runtime_error("Unexpected end of PNG data");
+        size_t len = in[pos] | in[pos + 1] << 8;
+        pos += 4;
+        if (pos + len > in_len)
+            throw runtime_error("Unexpected end of PNG data");
+        out.insert(out.end(), in + pos, in + pos + len);
+        pos += len;
+    }
+
+    void codes(const Huffman &lencode, const Huffman &distcode)
+    {
+        static const uint16_t lbase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+        static const uint8_t lext[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+        static const uint16_t dbase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+        static const uint8_t dext[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+        for (;;)
+        {
+            int symbol = decode(lencode);
+            if (symbol < 256)
+                out.push_back(symbol);
+            else if (symbol == 256)
+                return;
+            else
+            {
+                symbol -= 257;
+                if (symbol >= 29)
+                    throw runtime_error("Invalid length code");
+                size_t len = lbase[symbol] + bits(lext[symbol]);
+                symbol = decode(distcode);
+                if (symbol >= 30)
+                    throw runtime_error("Invalid distance code");
+                size_t dist = dbase[symbol] + bits(dext[symbol]);
+                if (dist > out.size())
+                    throw runtime_error("Distance too far back");
+                for (size_t i = 0; i < len; i++)
+                    out.push_back(out[out.size() - dist]);
+            }
+        }
+    }
+
+    void fixed()
+    {
+        static Huffman lencode, distcode;
+        static bool built = false;
+        if (!built)
+        {
+            uint8_t length[288];
+            memset(length, 8, 144);
+            memset(length + 144, 9, 112);
+            memset(length + 256, 7, 24);
+            memset(length + 280, 8, 8);
+            build(lencode, length, 288);
+            memset(length, 5, 30);
+            build(distcode, length, 30);
+            built = true;
+        }
+        codes(lencode, distcode);
+    }
+
+    void dynamic()
+    {
+        static const uint8_t order[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+        uint8_t length[320] = {0};
+        Huffman lencode, distcode;
+        int nlen = bits(5) + 257, ndist = bits(5) + 1, ncode = bits(4) + 4;
+        if (nlen > 286 || ndist > 30)
+            throw runtime_error("Invalid deflate block");
+        for (int i = 0; i < ncode; i++)
+            length[order[i]] = bits(3);
+        build(lencode, length, 19);
+        for (int i = 0; i < nlen + ndist;)
+        {
+            int symbol = decode(lencode);
+            if (symbol < 16)
+            {
+                length[i++] = symbol;
+                continue;
+            }
+            int len = 0, n;
+            if (symbol == 16)
+            {
+                if (!i)
+                    throw runtime_error("Invalid code lengths");
+                len = length[i - 1];
+                n = 3 + bits(2);
+            }
+            else if (symbol == 17)
+                n = 3 + bits(3);
+            else
+                n = 11 + bits(7);
+            if (i + n > nlen + ndist)
+                throw runtime_error("Invalid code lengths");
+            while (n--)
+                length[i++] = len;
+        }
+        build(lencode, length, nlen);
+        build(distcode, length + nlen, ndist);
+        codes(lencode, distcode);
+    }
+};
+
+static uint32_t be32(const uint8_t *p)
+{
+    return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static void load_png(const vector<uint8_t> &data, RgbImage &image)
+{
+    vector<uint8_t> idat, plte;
+    int depth = 0, type = 0;
+    for (size_t pos = 8; pos + 12 <= data.size();)
+    {
+        uint32_t len = be32(&data[pos]);
+        const uint8_t *chunk = &data[pos + 8];
+        if (pos + 12 + len > data.size())
+            throw runtime_error("PNG file too short");
+        if (!memcmp(&data[pos + 4], "IHDR", 4))
+        {
+            image.width = be32(chunk);
+            image.height = be32(chunk + 4);
+            depth = chunk[8];
+            type = chunk[9];
+            if (chunk[12])
+                throw runtime_error("Interlaced PNG files are not supported");
+        }
+        else if (!memcmp(&data[pos + 4], "PLTE", 4))
+            plte.assign(chunk, chunk + len);
+        else if (!memcmp(&data[pos + 4], "IDAT", 4))
+            idat.insert(idat.end(), chunk, chunk + len);
+        else if (!memcmp(&data[pos + 4], "IEND", 4))
+            break;
+        pos += 12 + len;
+    }
+    int channels;
+    switch (type)
+    {
+    case 0: // Grayscale
+    case 3: // Palette
+        channels = 1;
+        break;
+    case 2: // RGB
+        channels = 3;
+        break;
+    case 4: // Grayscale and alpha
+        channels = 2;
+        break;
+    case 6: // RGBA
+        channels = 4;
+        break;
+    default:
+        throw runtime_error("Invalid PNG color type");
+    }
+    if (image.width <= 0 || image.height <= 0 || idat.size() < 2 || !depth)
+        throw runtime_error("Invalid PNG file");
+
+    Inflate z(idat.data() + 2, idat.size() - 2); // Skip the zlib header
+    z.run();
+
+    // Undo the filters of each line
+    size_t bits = (size_t)channels * depth;
+    size_t stride = (image.width * bits + 7) / 8, bpp = (bits + 7) / 8;
+    if (z.out.size() < (stride + 1) * image.height)
+        throw runtime_error("PNG data too short");
+    vector<uint8_t> raw(stride * image.height);
+    for (int y = 0; y < image.height; y++)
+    {
+        const uint8_t *src = &z.out[(stride + 1) * y + 1];
+        uint8_t *line = &raw[stride * y], *prev = y ? line - stride : NULL;
+        uint8_t filter = src[-1];
+        for (size_t i = 0; i < stride; i++)
+        {
+            int a = i >= bpp ? line[i - bpp] : 0, b = prev ? prev[i] : 0, c = prev && i >= bpp ? prev[i - bpp] : 0;
+            int v = src[i];
+            switch (filter)
+            {
+            case 1:
+                v += a;
+                break;
+            case 2:
+                v += b;
+                break;
+            case 3:
+                v += (a + b) / 2;
+                break;
+            case 4:
+            {
+                int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+                v += (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+                break;
+            }
+            }
+            line[i] = v;
+        }
+    }
+
+    // Samples to RGB. Transparent pixels become black, the backdrop color of g2image
+    image.pixels.resize((size_t)image.width * image.height * 3);
+    for (int y = 0; y < image.height; y++)
+        for (int x = 0; x < image.width; x++)
+        {
+            const uint8_t *line = &raw[stride * y];
+            int s[4];
+            for (int ch = 0; ch < channels; ch++)
+            {
+                size_t bit = ((size_t)x * channels + ch) * depth;
+                if (depth >= 8)
+                    s[ch] = line[bit / 8]; // High byte of 16 bit samples
+                else
+                    s[ch] = line[bit / 8] >> (8 - depth - bit % 8) & ((1 << depth) - 1);
+            }
+            uint8_t *p = &image.pixels[((size_t)y * image.width + x) * 3];
+            if (type == 3)
+            {
+                if ((size_t)s[0] * 3 + 2 >= plte.size())
+                    throw runtime_error("Invalid PNG palette index");
+                memcpy(p, &plte[s[0] * 3], 3);
+                continue;
+            }
+            if (depth < 8)
+                s[0] = s[0] * 255 / ((1 << depth) - 1);
+            if (channels <= 2)
+            {
+                s[3] = channels == 2 ? s[1] : 255;
+                s[1] = s[2] = s[0];
+            }
+            else if (channels == 3)
+                s[3] = 255;
+            for (int ch = 0; ch < 3; ch++)
+                p[ch] = s[ch] * s[3] / 255;
+        }
+}
+
+string load_image(const char *fname, RgbImage &image)
+{
+    try
+    {
+        vector<uint8_t> data = read_file(fname);
+        if (data.size() >= 8 && !memcmp(data.data(), "\x89PNG\r\n\x1a\n", 8))
+            load_png(data, image);
+        else if (data.size() >= 2 && data[0] == 'P' && strchr("2356", data[1]))
+            load_ppm(data, image);
+        else
+            return "Unknown image format. Must be PNG or PPM";
+    }
+    catch (const exception &e)
+    {
+        return e.what();
+    }
+    return "";
+}
+
+RgbImage scale_image(const RgbImage &image)
+{
+    // Crop to 4:3
+    int cx = 0, cy = 0, cw = image.width, ch = image.height;
+    if (cw * 3 > ch * 4)
+    {
+        cw = ch * 4 / 3;
+        cx = (image.width - cw) / 2;
+    }
+    else
+    {
+        ch = cw * 3 / 4;
+        cy = (image.height - ch) / 2;
+    }
+    RgbImage out;
+    out.width = 256;
+    out.height = 192;
+    out.pixels.resize(256 * 192 * 3);
+    for (int y = 0; y < 192; y++)
+    {
+        int y0 = cy + y * ch / 192, y1 = cy + (y + 1) * ch / 192;
+        if (y1 <= y0)
+            y1 = y0 + 1;
+        for (int x = 0; x < 256; x++)
+        {
+            int x0 = cx + x * cw / 256, x1 = cx + (x + 1) * cw / 256;
+            if (x1 <= x0)
+                x1 = x0 + 1;
+            uint32_t sum[3] = {0};
+            for (int sy = y0; sy < y1; sy++)
+                for (int sx = x0; sx < x1; sx++)
+                    for (int c = 0; c < 3; c++)
+                        sum[c] += image.pixels[((size_t)sy * image.width + sx) * 3 + c];
+            uint32_t n = (y1 - y0) * (x1 - x0);
+            for (int c = 0; c < 3; c++)
+                out.pixels[(y * 256 + x) * 3 + c] = (sum[c] + n / 2) / n;
+        }
+    }
+    return out;
+}
+
+/********************************* Quantiser *********************************/
+// Weighted euclidean distance, the eye is most sensitive to green
+static inline int32_t distance(const int32_t *p, const uint8_t *c)
+{
+    int32_t dr = p[0] - c[0], dg = p[1] - c[1], db = p[2] - c[2];
+    return 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+}
+
+// Error of 8 pixels drawn with the colors a and b. Fixed size loop over the lanes, so the compiler vectorizes it
+static inline int32_t pair_error(const int32_t *da, const int32_t *db)
+{
+    int32_t sum = 0;
+    for (int i = 0; i < 8; i++)
+        sum += da[i] < db[i] ? da[i] : db[i];
+    return sum;
+}
+
+// Best pair of colors of 8 pixels by exhaustive search over all pairs
+static void best_pair(const int32_t px[8][3], uint8_t &a, uint8_t &b)
+{
+    int32_t d[N_COLORS][8];
+    for (int c = 0; c < N_COLORS; c++)
+        for (int i = 0; i < 8; i++)
+            d[c][i] = distance(px[i], palette[c + 1]);
+    int32_t best = INT32_MAX;
+    for (int i = 0; i < N_COLORS; i++)
+        for (int j = i; j < N_COLORS; j++)
+        {
+            int32_t e = pair_error(d[i], d[j]);
+            if (e < best)
+            {
+                best = e;
+                a = i + 1;
+                b = j + 1;
+            }
+        }
+}
+
+static inline int32_t clamp(int32_t v)
+{
+    return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+struct Quantiser
+{
+    const RgbImage &image;
+    uint8_t *tables;
+    bool dither;
+    vector<int32_t> err;            // Diffused error for each pixel of a line, 258 pixels incl. borders
+    vector<atomic<int>> progress; // Finished spans of 8 pixels of each line
+
+    Quantiser(const RgbImage &img, uint8_t *t, bool d) : image(img), tables(t), dither(d), err(d ? 193 * 258 * 3 : 0), progress(192)
+    {
+        for (auto &p : progress)
+            p = 0;
+    }
+
+    int32_t *error(int y, int x) { return &err[((size_t)y * 258 + x + 1) * 3]; }
+
+    // With dithering, a span depends on the error diffused from the line above up to the next span
+    void wait(int y, int span)
+    {
+        if (!dither || !y)
+            return;
+        int needed = span + 2 < 32 ? span + 2 : 32;
+        while (progress[y - 1].load(memory_order_acquire) < needed)
+            this_thread::yield();
+    }
+
+    void line(int y)
+    {
+        int32_t carry[3] = {0}; // Error diffused to the right
+        for (int span = 0; span < 32; span++)
+        {
+            wait(y, span);
+            int32_t px[8][3];
+            const uint8_t *src = &image.pixels[(y * 256 + span * 8) * 3];
+            for (int i = 0; i < 8; i++)
+                for (int c = 0; c < 3; c++)
+                    px[i][c] = clamp(src[i * 3 + c] + (dither ? error(y, span * 8 + i)[c] + (i ? 0 : carry[c]) : 0));
+            uint8_t a = 1, b = 1;
+            best_pair(px, a, b);
+
+            uint8_t bits = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                if (dither && i)
+                    for (int c = 0; c < 3; c++)
+                        px[i][c] = clamp(px[i][c] + carry[c]);
+                bool is_a = distance(px[i], palette[a]) <= distance(px[i], palette[b]);
+                bits = bits << 1 | is_a;
+                if (!dither)
+                    continue;
+                const uint8_t *pal = palette[is_a ? a : b];
+                int x = span * 8 + i;
+                for (int c = 0; c < 3; c++)
+                {
+                    int32_t e = px[i][c] - pal[c];
+                    carry[c] = e * 7 / 16;
+                    error(y + 1, x - 1)[c] += e * 3 / 16;
+                    error(y + 1, x)[c] += e * 5 / 16;
+                    error(y + 1, x + 1)[c] += e / 16;
+                }
+            }
+            // The more frequent color becomes the foreground, as in tms_image_cell()
+            if (a == b)
+                bits = 0;
+            else if (__builtin_popcount(bits) < 4)
+            {
+                bits = ~bits;
+                swap(a, b);
+            }
+            int i = (y / 8) * 256 + span * 8 + y % 8;
+            tables[i] = bits;
+            tables[TMS_IMAGE_TABLE_SIZE + i] = a << 4 | b;
+            progress[y].store(span + 1, memory_order_release);
+        }
+    }
+};
+
+void quantise_g2(const RgbImage &image, uint8_t *tables, bool dither, unsigned threads)
+{
+    if (!threads)
+        threads = thread::hardware_concurrency();
+    if (!threads)
+        threads = 1;
+    Quantiser q(image, tables, dither);
+    // Lines are interleaved, so with dithering the threads work on neighbouring lines like a wavefront
+    vector<thread> workers;
+    for (unsigned t = 0; t < threads; t++)
+        workers.emplace_back([&q, t, threads]()
+                             {
+                                 for (int y = t; y < 192; y += threads)
+                                     q.line(y);
+                             });
+    for (auto &w : workers)
+        w.join();
+}
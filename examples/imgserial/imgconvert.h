@@ -0,0 +1,48 @@
+/**
+ * @file imgconvert.h
+ * @author Doctor Volt
+ * @brief Converts PNG and PPM images into TMS images (see tmsimage.h), without GIMP or other tools
+ *
+ * The image is cropped to 4:3 and scaled to 256x192. For every 8 pixels of a line the pair of colors with the
+ * smallest error is searched among all pairs of the 15 TMS9918 colors, optionally with Floyd-Steinberg dithering.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef IMGCONVERT_H
+#define IMGCONVERT_H
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 8 bit RGB image
+ */
+struct RgbImage
+{
+    int width = 0, height = 0;
+    std::vector<uint8_t> pixels; // width * height * 3 bytes
+};
+
+/**
+ * @brief Load a PNG (8 and 16 bit, grayscale, RGB, palette, alpha; not interlaced) or a binary or ASCII PPM/PGM file
+ * @returns Empty string on success, else the error message
+ */
+std::string load_image(const char *fname, RgbImage &image);
+
+/**
+ * @brief Crop image to 4:3 and scale it to 256x192 by averaging the pixels
+ */
+RgbImage scale_image(const RgbImage &image);
+
+/**
+ * @brief Quantise a 256x192 image to the pattern and color tables of Graphics Mode 2
+ *
+ * @param image 256x192 pixels
+ * @param tables TMS_IMAGE_SIZE bytes: Pattern table followed by the color table
+ * @param dither Floyd-Steinberg error diffusion
+ * @param threads Number of threads, 0: One per CPU core
+ */
+void quantise_g2(const RgbImage &image, uint8_t *tables, bool dither, unsigned threads = 0);
+
+#endif
@@ -21,25 +21,391 @@
 #include <fcntl.h>
 #include <termios.h>
 #include <unistd.h>
+#include <strings.h>
+#include <poll.h>
+#include <algorithm>
 #include <sys/stat.h>
+#include <vector>
+#include <chrono>
+#include <deque>
+#include <thread>
+#include "../../src/tmsimage.h"
+#include "../../src/tmslink.h"
+#include "imgconvert.h"
 
 using namespace std;
 
-int main(int argc, const char *argv[])
+static bool has_extension(const string &fname, const char *ext)
+{
+    size_t n = strlen(ext);
+    return fname.size() > n && !strcasecmp(fname.c_str() + fname.size() - n, ext);
+}
+
+// Quantises a 256x192 GIMP raw data file, one palette index per pixel, into the tables of a TMS image
+static int load_data(const char *fname, uint8_t *tables)
+{
+    FILE *infile = fopen(fname, "rb");
+    if (!infile)
+    {
+        printf("Error opening file: %s\r\n", strerror(errno));
+        return -1;
+    }
+    static uint8_t pixels[256 * 192];
+    size_t n = fread(pixels, 1, sizeof(pixels), infile);
+    bool more = fgetc(infile) != EOF;
+    fclose(infile);
+    if (n != sizeof(pixels) || more)
+    {
+        printf("Invalid file format. Must be a 256x192 raw data file\r\n");
+        return -1;
+    }
+    // Pattern table followed by color table. The image covers the three thirds of the screen
+    for (int y = 0; y < 192; y++)
+        for (int cell = 0; cell < 32; cell++)
+        {
+            int i = (y / 8) * 256 + cell * 8 + y % 8;
+            tms_image_cell(pixels + 256 * y + 8 * cell, 1, tables[i], tables[TMS_IMAGE_TABLE_SIZE + i]); // Gimp palette index 0 is black
+        }
+    return 0;
+}
+
+// Pattern and color table of a GIMP raw data file or a PNG or PPM image
+static int make_tables(const char *fname, bool dither, uint8_t *tables, bool verbose = true)
+{
+    if (has_extension(fname, ".data"))
+    {
+        if (load_data(fname, tables))
+            return -1;
+    }
+    else
+    {
+        RgbImage image;
+        string error = load_image(fname, image);
+        if (!error.empty())
+        {
+            printf("%s: %s\r\n", fname, error.c_str());
+            return -1;
+        }
+        auto start = chrono::steady_clock::now();
+        quantise_g2(scale_image(image), tables, dither);
+        if (verbose)
+            printf("%s: %dx%d converted in %d ms\r\n", fname, image.width, image.height,
+                   (int)chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count());
+    }
+    return 0;
+}
+
+// Builds a TMS image (see tmsimage.h) from a GIMP raw data file or a PNG or PPM image
+static int make_tms(const char *fname, bool rle, bool dither, vector<uint8_t> &file)
+{
+    static uint8_t tables[TMS_IMAGE_SIZE], data[TMS_IMAGE_SIZE + TMS_IMAGE_SIZE / 128 + 1];
+    if (make_tables(fname, dither, tables))
+        return -1;
+
+    uint8_t flags = 0;
+    size_t size = TMS_IMAGE_SIZE;
+    memcpy(data, tables, size);
+    if (rle)
+    {
+        size_t packed = tms_rle_encode(tables, TMS_IMAGE_SIZE, data);
+        if (packed < TMS_IMAGE_SIZE)
+        {
+            flags |= TMS_IMAGE_RLE;
+            size = packed;
+        }
+        else
+            memcpy(data, tables, size); // Compression does not pay off
+    }
+    file.resize(TMS_IMAGE_HEADER_SIZE);
+    tms_image_header(file.data(), flags, size);
+    file.insert(file.end(), data, data + size);
+    return 0;
+}
+
+static int convert(const char *fname_in, const char *fname_out, bool rle, bool dither)
+{
+    vector<uint8_t> file;
+    if (make_tms(fname_in, rle, dither, file))
+        return -1;
+    FILE *outfile = fopen(fname_out, "wb");
+    if (!outfile || fwrite(file.data(), 1, file.size(), outfile) != file.size())
+    {
+        printf("Error writing file: %s\r\n", strerror(errno));
+        return -1;
+    }
+    fclose(outfile);
+    printf("%s: %d bytes%s\r\n", fname_out, (int)file.size(), file[4] & TMS_IMAGE_RLE ? ", RLE compressed" : "");
+    return 0;
+}
+
+// Sender side of the serial link (see tmslink.h)
+class LinkSender
+{
+public:
+    LinkSender(int port) : port(port) {}
+    int repeated = 0; // Frames sent more than once
+
+    // Splits data into frames and sends as many as the credit allows
+    bool write(const uint8_t *data, size_t len)
+    {
+        for (size_t i = 0; i < len; i += TMS_LINK_PAYLOAD)
+        {
+            size_t n = min(len - i, (size_t)TMS_LINK_PAYLOAD);
+            vector<uint8_t> frame(TMS_LINK_FRAME);
+            frame.resize(tms_link_frame(frame.data(), first + queue.size(), data + i, n));
+            queue.push_back(frame);
+        }
+        return pump(false);
+    }
+
+    // Waits until all frames are acknowledged
+    bool finish() { return pump(true); }
+
+    size_t frames() const { return first + queue.size(); }
+
+private:
+    int port;
+    deque<vector<uint8_t>> queue; // Frames without ACK, the first ones have been sent
+    size_t first = 0;             // Index of the first frame in the queue
+    size_t sent = 0;              // Frames of the queue sent
+    size_t in_flight = 0;         // Bytes sent without ACK
+    uint8_t reply[2];
+    size_t got = 0;
+    size_t unanswered = 0;        // Frames sent without a reply yet
+    size_t stale = 0;             // Replies still to come for frames sent before going back
+
+    bool pump(bool all)
+    {
+        int timeouts = 0;
+        for (;;)
+        {
+            while (sent < queue.size() && in_flight + queue[sent].size() <= TMS_LINK_CREDIT)
+            {
+                if (::write(port, queue[sent].data(), queue[sent].size()) != (ssize_t)queue[sent].size())
+                {
+                    printf("Error writing serial port: %s\r\n", strerror(errno));
+                    return false;
+                }
+                in_flight += queue[sent++].size();
+                unanswered++;
+            }
+            if (all ? queue.empty() : sent == queue.size())
+                return true;
+
+            pollfd p = {port, POLLIN, 0};
+            if (poll(&p, 1, TMS_LINK_TIMEOUT) <= 0)
+            {
+                if (++timeouts > TMS_LINK_RETRIES)
+                {
+                    printf("\r\nNo reply from the Arduino\r\n");
+                    return false;
+                }
+                goBack();
+                stale = unanswered = 0; // Lost
+                continue;
+            }
+            ssize_t r = read(port, reply + got, 2 - got);
+            if (r <= 0 || (got += r) < 2)
+                continue;
+            got = 0;
+
+            size_t n = (uint8_t)(reply[1] - first); // Frames acknowledged
+            if ((reply[0] != TMS_LINK_ACK && reply[0] != TMS_LINK_NAK) || n > sent)
+                continue; // Garbage
+            if (n)
+                timeouts = 0;
+            for (; n; n--)
+            {
+                in_flight -= queue.front().size();
+                queue.pop_front();
+                first++;
+                sent--;
+            }
+            // The receiver answers every damaged frame with a NAK, also the frames that were underway when the sender
+            // went back. Only NAKs for the repeated frames count
+            if (stale)
+                stale--;
+            else
+            {
+                if (unanswered)
+                    unanswered--;
+                if (reply[0] == TMS_LINK_NAK)
+                {
+                    goBack();
+                    stale = unanswered;
+                    unanswered = 0;
+                }
+            }
+        }
+    }
+
+    // Repeat all frames without ACK
+    void goBack()
+    {
+        repeated += sent;
+        sent = 0;
+        in_flight = 0;
+        got = 0;
+    }
+};
+
+// Sends a TMS image over the serial link. The first frame holds the header, the data follows when it is acknowledged
+static int send_tms(int port, const uint8_t *file, size_t filesize)
+{
+    uint8_t flags;
+    uint16_t size;
+    if (filesize < TMS_IMAGE_HEADER_SIZE || !tms_image_check(file, flags, size) || filesize != (size_t)TMS_IMAGE_HEADER_SIZE + size)
+    {
+        printf("\r\nInvalid TMS image\r\n");
+        return -1;
+    }
+    printf("\r\n256x192 Graphic Mode 2 TMS image, %d bytes%s\r\n", (int)filesize, flags & TMS_IMAGE_RLE ? ", RLE compressed" : "");
+    LinkSender link(port);
+    if (!link.write(file, TMS_IMAGE_HEADER_SIZE) || !link.finish() || // The Arduino sets up the screen
+        !link.write(file + TMS_IMAGE_HEADER_SIZE, size) || !link.finish())
+        return -1;
+    printf("%d frames, %d repeated\r\n", (int)link.frames(), link.repeated);
+    return 0;
+}
+
+// Frame of a stream (see tmsimage.h) with the cells that differ between prev and cur, or all cells for a keyframe
+static vector<uint8_t> delta_frame(const uint8_t *prev, const uint8_t *cur, bool key)
+{
+    vector<uint8_t> frame = {(uint8_t)(key ? TMS_STREAM_KEY : 0), 0, 0};
+    uint16_t records = 0;
+    for (int cell = 0; cell < TMS_STREAM_CELLS;)
+    {
+        if (!key && !memcmp(prev + cell * 8, cur + cell * 8, 8))
+        {
+            cell++;
+            continue;
+        }
+        int end = cell < TMS_STREAM_CELLS / 2 ? TMS_STREAM_CELLS / 2 : TMS_STREAM_CELLS; // Records stay within a table
+        int run = 1;
+        while (cell + run < end && run < 255 && (key || memcmp(prev + (cell + run) * 8, cur + (cell + run) * 8, 8)))
+            run++;
+        frame.push_back(cell & 0xFF);
+        frame.push_back(cell >> 8);
+        frame.push_back(run);
+        frame.insert(frame.end(), cur + cell * 8, cur + (cell + run) * 8);
+        records++;
+        cell += run;
+    }
+    frame[1] = records & 0xFF;
+    frame[2] = records >> 8;
+    return frame;
+}
+
+// Sends images as a stream of frames with the changed cells. Every keyframes frames all cells are sent
+static int send_stream(int port, const vector<const char *> &files, bool dither, int keyframes, int fps)
+{
+    static uint8_t prev[TMS_IMAGE_SIZE], cur[TMS_IMAGE_SIZE];
+    uint8_t header[TMS_IMAGE_HEADER_SIZE];
+    tms_image_header(header, 0, 0, TMS_STREAM_G2);
+    LinkSender link(port);
+    if (!link.write(header, sizeof(header)) || !link.finish()) // The Arduino sets up the screen
+        return -1;
+
+    auto start = chrono::steady_clock::now(), due = start;
+    size_t total = 0;
+    for (size_t f = 0; f < files.size(); f++)
+    {
+        if (make_tables(files[f], dither, cur, false))
+            return -1;
+        bool key = !f || (keyframes && f % keyframes == 0);
+        vector<uint8_t> frame = delta_frame(prev, cur, key);
+        if (fps)
+        {
+            this_thread::sleep_until(due);
+            due += chrono::microseconds(1000000 / fps);
+        }
+        if (!link.write(frame.data(), frame.size()))
+            return -1;
+        memcpy(prev, cur, sizeof(cur));
+        total += frame.size();
+        printf("\r%d/%d %s: %d bytes%s   ", (int)f + 1, (int)files.size(), files[f], (int)frame.size(), key ? ", keyframe" : "");
+        fflush(stdout);
+    }
+    uint8_t end[TMS_STREAM_FRAME_HEADER] = {TMS_STREAM_END, 0, 0};
+    if (!link.write(end, sizeof(end)) || !link.finish())
+        return -1;
+    double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    printf("\r\n%d frames, %d bytes per frame, %.1f frames/s, %d link frames repeated\r\n", (int)files.size(),
+           (int)(total / (files.size() ? files.size() : 1)), files.size() / t, link.repeated);
+    return 0;
+}
+
+// Opens the serial port at 115200 baud. Returns -1 on error
+static int open_port(const char *name)
 {
     termios tty;
     tty.c_iflag = 0;
     tty.c_oflag = 0;
     tty.c_cflag = CS8 | CREAD | CLOCAL; // 8 Bit, No parity, one stop bit, no flow control, disable signal lines, Read enabled
     tty.c_lflag = 0;
-    tty.c_cc[VMIN] = 5; // Block until at least one byte received
+    tty.c_cc[VMIN] = 1; // Block until at least one byte received
     tty.c_cc[VTIME] = 0;
     cfsetspeed(&tty, B115200);
 
-    if (argc != 3)
+    // int port = open("/dev/ttyUSB0", O_RDWR);
+    int port = open(name, O_RDWR);
+    if (port < 0)
+    {
+        printf("Error opening serial Port: %s\n", strerror(errno));
+        return -1;
+    }
+
+    // Setting port attributes
+    if (tcsetattr(port, TCSANOW, &tty) != 0)
+    {
+        printf("Error setting serial port: %s\n", strerror(errno));
+        return -1;
+    }
+    return port;
+}
+
+int main(int argc, const char *argv[])
+{
+    bool conv = false, rle = true, dither = false, stream = false;
+    int keyframes = 50, fps = 0;
+    vector<const char *> args;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "-c"))
+            conv = true;
+        else if (!strcmp(argv[i], "-s"))
+            stream = true;
+        else if (!strcmp(argv[i], "-k") && i + 1 < argc)
+            keyframes = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-r") && i + 1 < argc)
+            fps = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-u"))
+            rle = false;
+        else if (!strcmp(argv[i], "-d"))
+            dither = true;
+        else
+            args.push_back(argv[i]);
+    }
+    if (conv && args.size() == 2)
+        return convert(args[0], args[1], rle, dither);
+    if (stream && args.size() >= 2)
+    {
+        int port = open_port(args[0]);
+        if (port < 0)
+            return -1;
+        int r = send_stream(port, vector<const char *>(args.begin() + 1, args.end()), dither, keyframes, fps);
+        close(port);
+        return r;
+    }
+
+    if (args.size() != 2)
     {
         printf("This program sends GIMP raw data files to an Arduino running the \"g2image\" example over serial(USB) interface\r\n");
         printf("\r\nUsage: imgserial filename.data port \r\n");
+        printf("       imgserial [-d] [-u] filename.tms|png|ppm port \r\n");
+        printf("       imgserial -c [-d] [-u] filename.data|png|ppm filename.tms  Convert into a TMS image\r\n");
+        printf("       imgserial -s [-d] [-k n] [-r fps] port frame1.png frame2.png ...  Stream the images as animation\r\n");
+        printf("       -d: Dithering, -u: Uncompressed, -k: Keyframe every n frames (0: only the first, default 50), -r: Maximum frame rate\r\n");
 #ifdef __CYGWIN__
         printf("Example: imgserial parrot.data /dev/ttyS0 where /dev/ttyS0 is COM1, /dev/ttyS1 COM2 etc. \r\n");
 #else
@@ -52,42 +418,64 @@ int main(int argc, const char *argv[])
 #endif
 
 
-    string fname_in = argv[1];
-    if (fname_in.rfind(".data", string::npos) == -1)
+    string fname_in = args[0];
+    const char *fname_port = args[1];
+    bool tms = has_extension(fname_in, ".tms");
+    bool picture = has_extension(fname_in, ".png") || has_extension(fname_in, ".ppm") || has_extension(fname_in, ".pgm") || has_extension(fname_in, ".pnm");
+    if (!has_extension(fname_in, ".data") && !tms && !picture)
     {
-        printf("Invalid filename. Must be a *.data file\r\n");
+        printf("Invalid filename. Must be a *.data, *.tms, *.png or *.ppm file\r\n");
         return -1;
     }
+    vector<uint8_t> converted;
+    if (picture && make_tms(fname_in.c_str(), rle, dither, converted))
+        return -1;
 
     // FILE *infile = fopen(fname_in.c_str(), "r");
     int infile = open(fname_in.c_str(), O_RDONLY);
-    if (errno)
+    if (infile < 0)
     {
         printf("Error opening file: %s\r\n", strerror(errno));
         return -1;
     }
 
     // Opening serial port
-    // int port = open("/dev/ttyUSB0", O_RDWR);
-    int port = open(argv[2], O_RDWR);
-    if (errno)
-    {
-        printf("Error opening serial Port: %s\n", strerror(errno));
+    int port = open_port(fname_port);
+    if (port < 0)
         return -1;
-    }
-
-    // Setting port attributes
-    if (tcsetattr(port, TCSANOW, &tty) != 0)
-    {
-        printf("Error setting serial port: %s\n", strerror(errno));
-        return -1;
-    }
 
     // Determine filesize
     struct stat buf;
     fstat(infile, &buf);
     size_t filesize = buf.st_size;
 
+    if (filesize == 256 * 192 && !tms && !picture)
+    {
+        if (make_tms(fname_in.c_str(), rle, dither, converted))
+            return -1;
+        picture = true; // Hi-res data files are converted on the PC
+    }
+
+    if (tms || picture)
+    {
+        if (tms)
+        {
+            converted.resize(filesize);
+            if (read(infile, converted.data(), filesize) != (ssize_t)filesize)
+            {
+                printf("Error reading file: %s\r\n", strerror(errno));
+                return -1;
+            }
+        }
+        printf("Transfer started: %s to %s...\r\n", fname_in.c_str(), fname_port);
+        if (send_tms(port, converted.data(), converted.size()))
+            return -1;
+        close(port);
+        close(infile);
+        printf("\r\nFile sent\r\n");
+        return 0;
+    }
+
     uint16_t n_cols, n_lines;
     switch (filesize)
     {
@@ -107,7 +495,7 @@ int main(int argc, const char *argv[])
     }
     uint8_t ack;
     // read(port, &ack, 1); //Block until Arduino is ready
-    printf("Transfer started: %s to %s...\r\n", argv[1], argv[2]);
+    printf("Transfer started: %s to %s...\r\n", fname_in.c_str(), fname_port);
     write(port, (uint8_t *)&n_cols, 1); // Send resolution
     write(port, (uint8_t *)&n_lines, 1);
     uint8_t *inbuf = (uint8_t *)calloc(1, filesize);
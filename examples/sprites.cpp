@@ -59,18 +59,18 @@ const int xmin = 16;
 const int ymin = 16;
 const int ymax = 180;
 
-uint16_t sprite_names[32];
+VdpSpriteTable sprite_table;
 
 
-void move(uint16_t handle)
+void move(uint8_t sprite)
 {
     static double speeds[32];
     static double x_positions[32];
     static uint8_t y_positions[32];
 
-    double &s = speeds[(handle & 0xFF) / 4];
-    double &x = x_positions[(handle & 0xFF) / 4];
-    uint8_t &y = y_positions[(handle & 0xFF) / 4];
+    double &s = speeds[sprite];
+    double &x = x_positions[sprite];
+    uint8_t &y = y_positions[sprite];
 
     if (x <= xmin)
     {
@@ -78,10 +78,10 @@ void move(uint16_t handle)
         s = 0.5 * s + 0.1;
         y = 16 * (int)((double)12 * rand() / RAND_MAX);
         x = xmin;
-        vdp_sprite_color(handle, 2 + (int)((double)13 * rand() / RAND_MAX));
+        sprite_table.set_color(sprite, 2 + (int)((double)13 * rand() / RAND_MAX));
     }
     x += s;
-    vdp_sprite_set_position(handle, x, y);
+    sprite_table.set_position(sprite, x, y);
 }
 
 void sprites()
@@ -100,14 +100,15 @@ void sprites()
     vdp_set_sprite_pattern(9, fish);
     for (uint8_t i = 0; i <= 31; i++)
     {
-        sprite_names[i] = vdp_sprite_init(i % 10, i);
+        sprite_table.set_pattern(i, i % 10);
     }
     while (1)
     {
         for (uint8_t i = 0; i < 32; i++)
         {
-            move(sprite_names[i]);
+            move(i);
         }
+        sprite_table.commit(); // All sprites in one go
         delay(10);
     }
 }
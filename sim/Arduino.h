@@ -0,0 +1,134 @@
+/**
+ * @file Arduino.h
+ * @author Doctor Volt
+ * @brief Host stand-in for the Arduino core. Just enough to build the library and the examples against the VDP simulator.
+ * Time is the modelled time of the simulator, Serial is stdin/stdout.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef ARDUINO_H_SIM
+#define ARDUINO_H_SIM
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include "avr/pgmspace.h"
+#include "vdp_sim.h"
+
+#define F_CPU VDP_SIM_F_CPU
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+#define LOW_LEVEL 0
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define DEC 10
+#define HEX 16
+#define B00001111 0x0F
+#define B11110000 0xF0
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+unsigned long millis();
+unsigned long micros();
+
+// External interrupts. Only the falling edge of INT on VDP_SIM_PIN_INT is modelled
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : -1))
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode);
+void detachInterrupt(uint8_t interrupt);
+void interrupts();
+void noInterrupts();
+
+class String
+{
+public:
+    String(const char *s = "") : s_(s) {}
+    String(const std::string &s) : s_(s) {}
+    char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+    unsigned int length() const { return s_.size(); }
+    const char *c_str() const { return s_.c_str(); }
+    String substring(unsigned int from) const { return from < s_.size() ? s_.substr(from) : ""; }
+    String substring(unsigned int from, unsigned int to) const { return from < to && from < s_.size() ? s_.substr(from, to - from) : ""; }
+    int indexOf(const char *c, unsigned int from = 0) const { return (int)s_.find(c, from); }
+    int indexOf(char c, unsigned int from = 0) const { return (int)s_.find(c, from); }
+    long toInt() const { return atol(s_.c_str()); }
+    void remove(unsigned int index, unsigned int count) { s_.erase(index, count); }
+
+private:
+    std::string s_;
+};
+
+// Text in program memory, see F()
+class __FlashStringHelper;
+#define F(s) ((const __FlashStringHelper *)PSTR(s))
+
+class Print
+{
+public:
+    virtual size_t write(uint8_t) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *str) { return write((const uint8_t *)str, strlen(str)); }
+    size_t print(const char *s) { return write(s); }
+    size_t print(const String &s) { return write(s.c_str()); }
+    size_t print(const __FlashStringHelper *s) { return write((const char *)s); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(long n, int base = 10);
+    size_t print(unsigned long n, int base = 10);
+    size_t print(int n, int base = 10) { return print((long)n, base); }
+    size_t print(unsigned int n, int base = 10) { return print((unsigned long)n, base); }
+    size_t print(double n, int digits = 2);
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(T v) { return print(v) + println(); }
+    template <typename T>
+    size_t println(T v, int base) { return print(v, base) + println(); }
+};
+
+class HardwareSerial : public Print
+{
+public:
+    void begin(unsigned long) {}
+    int available();
+    int read();
+    size_t readBytes(uint8_t *buffer, size_t length);
+    size_t readBytes(char *buffer, size_t length) { return readBytes((uint8_t *)buffer, length); }
+    void setTimeout(unsigned long ms) { timeout_ = ms; }
+    size_t write(uint8_t c) override;
+    using Print::write;
+    /**
+     * @brief Use file descriptors other than stdin and stdout
+     */
+    void attach(int in_fd, int out_fd)
+    {
+        in_ = in_fd;
+        out_ = out_fd;
+    }
+    int fd() const { return in_; }
+    /**
+     * @brief Flip a bit in every nth received byte, to test transfer protocols. 0: No errors
+     */
+    void inject_errors(uint32_t n) { error_rate_ = n; }
+
+private:
+    int in_ = 0, out_ = 1;
+    unsigned long timeout_ = 1000;
+    uint32_t error_rate_ = 0, received_ = 0;
+    void damage(uint8_t *buffer, size_t length);
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,185 @@
+/* Host stand-in for the Arduino core, used with the VDP simulator
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <poll.h>
+#include <unistd.h>
+#include "Arduino.h"
+
+HardwareSerial Serial;
+
+void pinMode(uint8_t, uint8_t)
+{
+    vdp_sim_cycles(VDP_SIM_CYCLES_PINMODE);
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    vdp_sim_cycles(VDP_SIM_CYCLES_DIGITALWRITE);
+    vdp_sim_pin(pin, val);
+}
+
+int digitalRead(uint8_t pin)
+{
+    vdp_sim_cycles(VDP_SIM_CYCLES_DIGITALWRITE);
+    return pin == VDP_SIM_PIN_INT ? vdp_sim_int() : HIGH;
+}
+
+static void (*isr)();
+static bool isr_enabled = true, isr_pending;
+
+// Called by the simulator at the falling edge of INT
+static void int_falling()
+{
+    if (isr_enabled)
+        isr();
+    else
+        isr_pending = true;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(), int mode)
+{
+    if (interrupt != digitalPinToInterrupt(VDP_SIM_PIN_INT) || mode != FALLING)
+        return;
+    isr = handler;
+    isr_pending = false;
+    vdp_sim_attach_int(int_falling);
+}
+
+void detachInterrupt(uint8_t interrupt)
+{
+    if (interrupt == digitalPinToInterrupt(VDP_SIM_PIN_INT))
+        vdp_sim_attach_int(nullptr);
+}
+
+void interrupts()
+{
+    vdp_sim_cycles(1); // sei
+    isr_enabled = true;
+    if (isr_pending)
+    {
+        isr_pending = false;
+        isr();
+    }
+}
+
+void noInterrupts()
+{
+    isr_enabled = false;
+    vdp_sim_cycles(1); // cli
+}
+
+void delay(unsigned long ms)
+{
+    vdp_sim_cycles(ms * (VDP_SIM_F_CPU / 1000));
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    vdp_sim_cycles(us * VDP_SIM_CYCLES_PER_US);
+}
+
+unsigned long millis()
+{
+    return vdp_sim_clock() / (VDP_SIM_F_CPU / 1000);
+}
+
+unsigned long micros()
+{
+    return vdp_sim_clock() / VDP_SIM_CYCLES_PER_US;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--)
+        n += write(*buffer++);
+    return n;
+}
+
+size_t Print::print(long n, int base)
+{
+    if (n < 0 && base == 10)
+        return print('-') + print((unsigned long)-n, base);
+    return print((unsigned long)n, base);
+}
+
+size_t Print::print(unsigned long n, int base)
+{
+    char buf[8 * sizeof(long) + 1];
+    char *s = &buf[sizeof(buf) - 1];
+    *s = 0;
+    if (base < 2)
+        base = 10;
+    do
+    {
+        char c = n % base;
+        n /= base;
+        *--s = c < 10 ? c + '0' : c + 'A' - 10;
+    } while (n);
+    return write(s);
+}
+
+size_t Print::print(double n, int digits)
+{
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return write(buf);
+}
+
+int HardwareSerial::available()
+{
+    pollfd p = {in_, POLLIN, 0};
+    return poll(&p, 1, 0) > 0 && (p.revents & POLLIN) ? 1 : 0;
+}
+
+void HardwareSerial::damage(uint8_t *buffer, size_t length)
+{
+    for (size_t i = 0; i < length && error_rate_; i++)
+        if (++received_ % error_rate_ == 0)
+            buffer[i] ^= 0x10;
+}
+
+int HardwareSerial::read()
+{
+    uint8_t c;
+    if (!available() || ::read(in_, &c, 1) != 1)
+        return -1;
+    damage(&c, 1);
+    return c;
+}
+
+size_t HardwareSerial::readBytes(uint8_t *buffer, size_t length)
+{
+    size_t n = 0;
+    while (n < length)
+    {
+        pollfd p = {in_, POLLIN, 0};
+        if (poll(&p, 1, timeout_) <= 0)
+            break;
+        ssize_t r = ::read(in_, buffer + n, length - n);
+        if (r <= 0)
+            break;
+        damage(buffer + n, r);
+        n += r;
+    }
+    return n;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return ::write(out_, &c, 1) == 1;
+}
@@ -0,0 +1,18 @@
+/**
+ * @file pgmspace.h
+ * @brief Host stand-in for avr/pgmspace.h. Program memory is ordinary memory on the host.
+ */
+#ifndef PGMSPACE_H_SIM
+#define PGMSPACE_H_SIM
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define memcpy_P memcpy
+#define strlen_P strlen
+
+#endif
@@ -0,0 +1,36 @@
+#!/bin/sh
+# Regression tests on the VDP simulator. Run from the root folder of the library: sh sim/test.sh
+set -e
+BUILD=${BUILD:-/tmp/vdp_test}
+mkdir -p $BUILD
+
+echo "Renderer"
+g++ -O2 -DVDP_SIM -Isim -Isrc sim/vdp_sim.cpp sim/vdp_render.cpp sim/arduino.cpp sim/tools/rendertest.cpp -o $BUILD/rendertest
+$BUILD/rendertest sim/render_golden.txt
+
+echo "Benchmark"
+g++ -O2 -DVDP_SIM -Isim -Isrc sim/*.cpp src/*.cpp sim/tools/bench.cpp -o $BUILD/bench
+$BUILD/bench --compare sim/bench_baseline.csv > $BUILD/bench.txt || { cat $BUILD/bench.txt; exit 1; }
+tail -n 1 $BUILD/bench.txt
+
+echo "Serial link"
+g++ -O2 -DVDP_SIM -Isim -Isrc sim/*.cpp src/*.cpp examples/*.cpp sim/tools/vdpsim.cpp -o $BUILD/vdpsim
+g++ -O2 -pthread examples/imgserial/imgserial.cpp examples/imgserial/imgconvert.cpp -o $BUILD/imgserial
+$BUILD/imgserial -c examples/imgserial/parrot.data $BUILD/parrot.tms > /dev/null
+# Sends the image to g2image over a pseudo terminal. $1: Bit errors every n bytes, 0: none
+link() {
+    $BUILD/vdpsim g2image --pty --idle 2000 --ms 600000 --serial-errors $1 -o $BUILD/link$1.ppm 2> $BUILD/link.err &
+    pid=$!
+    port=
+    while [ -z "$port" ]; do
+        sleep 0.1
+        port=$(grep -o '/dev/pts/[0-9]*' $BUILD/link.err | head -n 1)
+    done
+    timeout 120 $BUILD/imgserial $BUILD/parrot.tms $port | grep repeated
+    wait $pid
+}
+link 0
+link 50 # More than every second frame is damaged
+cmp $BUILD/link0.ppm $BUILD/link50.ppm
+
+echo "All tests passed"
@@ -0,0 +1,562 @@
+/* Cycle count benchmark of the TMS9918 Arduino library on the VDP simulator
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <Arduino.h>
+#include <tms9918.h>
+#include <vdp_pins.h>
+#include <vdp_sprite_mux.h>
+#include <vdp_image.h>
+#include <vdp_console.h>
+#include <vdp_lowres.h>
+#include <vdp_gfx.h>
+#include <vdp_mode.h>
+#include <vdp_diag.h>
+
+static uint8_t buffer[1024];
+static uint8_t tms_data[TMS_IMAGE_HEADER_SIZE + TMS_IMAGE_SIZE + TMS_IMAGE_SIZE / 128 + 1];
+
+// Every measurement, for --csv and --compare. Totals of all runs, the simulator is deterministic
+struct Result
+{
+    char name[48];
+    uint32_t runs;
+    uint64_t cycles;
+    uint32_t vram, address_setups, ctrl_writes, violations;
+};
+static std::vector<Result> results;
+
+static void record(const char *table, const char *name, uint32_t n, const VdpSimStats &s)
+{
+    Result r = {"", n, s.cycles, s.vram_writes + s.vram_reads, s.address_setups, s.ctrl_writes, s.access_violations};
+    snprintf(r.name, sizeof(r.name), "%s%s%s", table, *table ? " " : "", name);
+    results.push_back(r);
+}
+
+static void fillJob(void *arg)
+{
+    vdp_fill(0x0000, *(uint8_t *)arg, 256);
+}
+
+static bool stripes(uint8_t *row, uint8_t y)
+{
+    for (uint16_t x = 0; x < 256; x++)
+        row[x] = (x + y) / 8 & 15;
+    return true;
+}
+
+static void report(const char *name, uint32_t n, const VdpSimStats &s)
+{
+    record("", name, n, s);
+    printf("%-28s %10.1f %10.2f %10.2f %10.2f %8u\r\n", name, (double)s.cycles / n,
+           (double)(s.vram_writes + s.vram_reads) / n, (double)s.address_setups / n,
+           (double)s.ctrl_writes / n, s.access_violations);
+}
+
+// Prints 24 full rows and reports the throughput
+static void textRedraw(const char *name, uint8_t cols)
+{
+    char line[41];
+    for (uint8_t i = 0; i < cols; i++)
+        line[i] = 'A' + i % 26;
+    line[cols] = 0;
+    vdp_set_cursor(0, 0);
+    VdpSimStats before = vdp_sim_stats();
+    for (uint8_t r = 0; r < 24; r++)
+        vdp_print(line);
+    VdpSimStats s = vdp_sim_diff(vdp_sim_stats(), before);
+    record("text", name, 1, s);
+    double seconds = (double)s.cycles / VDP_SIM_F_CPU;
+    printf("%-28s %10.1f %10.0f %10.0f %8u\r\n", name, seconds * 1000, 24 * cols / seconds,
+           (s.vram_writes + s.vram_reads) / seconds, s.access_violations);
+}
+
+// Time from vdp_init() and from vdp_set_mode(), which keeps VRAM, until the screen is shown
+static void bootTime(const char *name, uint8_t mode, uint8_t color)
+{
+    VdpSimStats before = vdp_sim_stats();
+    vdp_init(mode, color, false, false);
+    VdpSimStats cold = vdp_sim_diff(vdp_sim_stats(), before);
+    before = vdp_sim_stats();
+    vdp_set_mode(mode, color, false, false);
+    VdpSimStats warm = vdp_sim_diff(vdp_sim_stats(), before);
+    char full[40];
+    snprintf(full, sizeof(full), "%s init", name);
+    record("boot", full, 1, cold);
+    snprintf(full, sizeof(full), "%s warm", name);
+    record("boot", full, 1, warm);
+    printf("%-28s %10.2f %10.2f %10u %10u %8u\r\n", name, cold.cycles * 1000.0 / VDP_SIM_F_CPU,
+           warm.cycles * 1000.0 / VDP_SIM_F_CPU, cold.vram_writes, warm.vram_writes,
+           cold.access_violations + warm.access_violations);
+}
+
+static void clearG2()
+{
+    vdp_fill(vdp_pattern_table(), 0, 0x1800);
+    vdp_fill(vdp_color_table(), 0, 0x1800);
+}
+
+// The same shapes pixel by pixel, as the baseline of vdp_gfx.h
+static void plotLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color)
+{
+    int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1, dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1, err = dx + dy;
+    while (true)
+    {
+        vdp_plot_hires(x0, y0, color);
+        if (x0 == x1 && y0 == y1)
+            break;
+        int16_t e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+}
+
+static void plotCircle(int16_t cx, int16_t cy, int16_t r, uint8_t color)
+{
+    for (int16_t dy = -r; dy <= r; dy++)
+        for (int16_t dx = -r; dx <= r; dx++)
+            if (dx * dx + dy * dy <= r * r + r)
+                vdp_plot_hires(cx + dx, cy + dy, color);
+}
+
+// Workloads of the examples, reported as totals
+static void workload(const char *name, void (*run)())
+{
+    VdpSimStats before = vdp_sim_stats();
+    run();
+    VdpSimStats s = vdp_sim_diff(vdp_sim_stats(), before);
+    record("workload", name, 1, s);
+    printf("%-28s %10.1f %10u %10u %10u %8u\r\n", name, s.cycles * 1000.0 / VDP_SIM_F_CPU,
+           s.vram_writes + s.vram_reads, s.address_setups, s.ctrl_writes, s.access_violations);
+}
+
+static void hiresFill()
+{
+    for (uint8_t y = 0; y < 192; y++)
+        for (uint16_t x = 0; x < 256; x++)
+            vdp_plot_hires(x, y, (x ^ y) & 8 ? VDP_WHITE : 0, VDP_DARK_BLUE);
+}
+
+static void multicolorFill()
+{
+    for (uint8_t y = 0; y < 48; y++)
+        for (uint8_t x = 0; x < 64; x++)
+            vdp_plot_color(x, y, (x + y) % 15 + 1);
+}
+
+// 32 sprites crossing the screen at different speeds for 100 frames, as in examples/sprites.cpp
+static void spriteMovement()
+{
+    static VdpSpriteTable table;
+    uint16_t x[32]; // In 1/16 pixels
+    for (uint8_t s = 0; s < 10; s++)
+        vdp_set_sprite_pattern(s, buffer + 32 * s);
+    for (uint8_t s = 0; s < 32; s++)
+    {
+        x[s] = (16 + s * 8) * 16;
+        table.set_pattern(s, s % 10);
+        table.set_color(s, 2 + s % 13);
+    }
+    for (uint8_t frame = 0; frame < 100; frame++)
+    {
+        for (uint8_t s = 0; s < 32; s++)
+        {
+            x[s] += 2 + s % 8; // 0.1 to 0.6 pixels per frame
+            if (x[s] > 287 * 16)
+            {
+                x[s] = 16 * 16;
+                table.set_color(s, 2 + (s + frame) % 13);
+            }
+            table.set_position(s, x[s] / 16, 16 * (s % 12));
+        }
+        table.commit();
+    }
+}
+
+// Hi-res image as the g2image example loads it from imgserial
+static void imageLoad()
+{
+    vdp_load_g2_bitmap(stripes, 1);
+}
+
+// TMS image of stripes in tms_data, rle: Compressed. Returns the size with header
+static uint16_t tmsImage(bool rle)
+{
+    static uint8_t image[TMS_IMAGE_SIZE];
+    for (uint16_t i = 0; i < TMS_IMAGE_TABLE_SIZE; i++)
+    {
+        image[i] = i & 0x100 ? 0xF0 : i * 37;
+        image[TMS_IMAGE_TABLE_SIZE + i] = ((i >> 6) % 15 + 1) << 4 | 1;
+    }
+    uint16_t size = TMS_IMAGE_SIZE;
+    if (rle)
+        size = tms_rle_encode(image, TMS_IMAGE_SIZE, tms_data + TMS_IMAGE_HEADER_SIZE);
+    else
+        memcpy(tms_data + TMS_IMAGE_HEADER_SIZE, image, TMS_IMAGE_SIZE);
+    tms_image_header(tms_data, rle ? TMS_IMAGE_RLE : 0, size);
+    return TMS_IMAGE_HEADER_SIZE + size;
+}
+
+// Feeds tms_data in blocks of 64 bytes, as they arrive from the serial link
+static void tmsLoad(uint16_t len)
+{
+    static VdpTmsLoader loader;
+    loader.begin(tms_data);
+    for (uint16_t i = TMS_IMAGE_HEADER_SIZE; i < len; i += 64)
+        loader.write(tms_data + i, len - i < 64 ? len - i : 64);
+}
+
+// Stream in tms_data of 10 frames that change 16 cells of the pattern table and 16 of the color table each.
+// Returns the size without the stream header
+static uint16_t tmsStream()
+{
+    uint16_t n = 0;
+    for (uint8_t f = 0; f < 10; f++)
+    {
+        uint8_t frame[] = {0, 2, 0};
+        memcpy(tms_data + n, frame, sizeof(frame));
+        n += sizeof(frame);
+        for (uint16_t cell = 32 * f; cell < TMS_STREAM_CELLS; cell += TMS_STREAM_CELLS / 2)
+        {
+            uint8_t record[] = {(uint8_t)cell, (uint8_t)(cell >> 8), 16};
+            memcpy(tms_data + n, record, sizeof(record));
+            n += sizeof(record);
+            for (uint8_t i = 0; i < 128; i++)
+                tms_data[n++] = f + i;
+        }
+    }
+    uint8_t end[] = {TMS_STREAM_END, 0, 0};
+    memcpy(tms_data + n, end, sizeof(end));
+    return n + sizeof(end);
+}
+
+static void streamPlay(uint16_t len)
+{
+    static VdpStreamPlayer player;
+    player.begin();
+    for (uint16_t i = 0; i < len; i += 64)
+        player.write(tms_data + i, len - i < 64 ? len - i : 64);
+}
+
+static bool writeCsv(const char *path)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+    fprintf(f, "name,runs,cycles,vram,address_setups,ctrl_writes,violations\n");
+    for (const Result &r : results)
+        fprintf(f, "%s,%u,%llu,%u,%u,%u,%u\n", r.name, r.runs, (unsigned long long)r.cycles, r.vram, r.address_setups,
+                r.ctrl_writes, r.violations);
+    return !fclose(f);
+}
+
+// Lists the measurements that changed against a file of --csv.
+// Returns the number of measurements that got worse by more than tolerance percent or are missing, -1 if the file
+// cannot be read
+static int compare(const char *path, double tolerance)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return -1;
+    std::vector<Result> base;
+    char line[160];
+    while (fgets(line, sizeof(line), f))
+    {
+        Result r;
+        unsigned long long cycles;
+        if (sscanf(line, "%47[^,],%u,%llu,%u,%u,%u,%u", r.name, &r.runs, &cycles, &r.vram, &r.address_setups,
+                   &r.ctrl_writes, &r.violations) == 7)
+        {
+            r.cycles = cycles;
+            base.push_back(r);
+        }
+    }
+    fclose(f);
+
+    int worse = 0;
+    printf("\r\nCompared with %s, tolerance %.1f%%\r\n", path, tolerance);
+    printf("%-36s %-10s %12s %12s %8s\r\n", "", "", "baseline", "now", "change");
+    for (const Result &r : results)
+    {
+        const Result *b = NULL;
+        for (const Result &c : base)
+            if (!strcmp(c.name, r.name))
+                b = &c;
+        if (!b)
+        {
+            printf("%-36s new\r\n", r.name);
+            continue;
+        }
+        const struct
+        {
+            const char *metric;
+            uint64_t was, now;
+        } metrics[] = {{"cycles", b->cycles, r.cycles}, {"VRAM", b->vram, r.vram}, {"addr", b->address_setups, r.address_setups},
+                       {"ctrl", b->ctrl_writes, r.ctrl_writes}, {"violat.", b->violations, r.violations}};
+        for (const auto &m : metrics)
+        {
+            if (m.was == m.now)
+                continue;
+            double change = m.was ? 100.0 * ((double)m.now - m.was) / m.was : 100.0;
+            bool regression = m.now > m.was && change > tolerance;
+            worse += regression;
+            printf("%-36s %-10s %12llu %12llu %+7.1f%%%s\r\n", r.name, m.metric, (unsigned long long)m.was,
+                   (unsigned long long)m.now, change, regression ? " worse" : "");
+        }
+    }
+    for (const Result &b : base)
+    {
+        bool found = false;
+        for (const Result &r : results)
+            found |= !strcmp(b.name, r.name);
+        if (!found)
+        {
+            printf("%-36s missing\r\n", b.name);
+            worse++; // Removed or renamed, the baseline needs an update
+        }
+    }
+    printf("%d measurements worse or missing\r\n", worse);
+    return worse;
+}
+
+// Runs op n times and reports the cost per run
+#define BENCH(name, n, op)                                        \
+    do                                                            \
+    {                                                             \
+        VdpSimStats before = vdp_sim_stats();                     \
+        for (uint32_t i = 0; i < (n); i++)                        \
+            op;                                                   \
+        report(name, n, vdp_sim_diff(vdp_sim_stats(), before));   \
+    } while (0)
+
+int main(int argc, const char *argv[])
+{
+    const char *csv = NULL, *baseline = NULL;
+    double tolerance = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--csv") && i + 1 < argc)
+            csv = argv[++i];
+        else if (!strcmp(argv[i], "--compare") && i + 1 < argc)
+            baseline = argv[++i];
+        else if (!strcmp(argv[i], "--tolerance") && i + 1 < argc)
+            tolerance = atof(argv[++i]);
+        else
+        {
+            fprintf(stderr, "Usage: bench [--csv results.csv] [--compare baseline.csv [--tolerance percent]]\r\n");
+            return -1;
+        }
+    }
+
+    vdp_sim_power_on();
+    printf("%-28s %10s %10s %10s %10s %8s\r\n", "", "cycles", "VRAM", "addr", "ctrl", "violat.");
+#ifdef VDP_DIRECT_PINS
+    printf("Control lines: direct port access\r\n");
+#else
+    printf("Control lines: digitalWrite()\r\n");
+#endif
+
+    BENCH("vdp_init G2", 1, vdp_init_g2());
+    BENCH("vdp_set_bdcolor", 100, vdp_set_bdcolor(i & 0x0F));
+    BENCH("vdp_fill 1k", 4, vdp_fill(0x0000, i, 1024));
+    BENCH("vdp_write_block 1k", 4, vdp_write_block(0x0000, buffer, 1024));
+    BENCH("vdp_write_block_P 1k", 4, vdp_write_block_P(0x0000, buffer, 1024));
+    BENCH("vdp_read_block 1k", 4, vdp_read_block(0x0000, buffer, 1024));
+    BENCH("vdp_plot_hires", 256, vdp_plot_hires(i, 10, VDP_WHITE));
+    BENCH("vdp_plot_hires_mask", 32, vdp_plot_hires_mask(8 * i, 12, 0x5A, VDP_WHITE));
+    BENCH("vdp_plot_color G2", 64, vdp_plot_color(i, 10, VDP_WHITE));
+    BENCH("vdp_plot_color G2 new row", 64, vdp_plot_color(i, 18, VDP_WHITE));
+    BENCH("Vdp<G2>::plot_color new row", 64, Vdp<VDP_MODE_G2>::plot_color(i, 26, VDP_WHITE));
+    uint16_t sprite = vdp_sprite_init(0, 0, VDP_WHITE);
+    BENCH("vdp_sprite_set_position", 100, vdp_sprite_set_position(sprite, i, 10));
+    BENCH("vdp_sprite_color", 100, vdp_sprite_color(sprite, i & 0x0F));
+    BENCH("vdp_sprite_get_attributes", 100, vdp_sprite_get_attributes(sprite));
+    uint16_t x;
+    uint8_t y;
+    BENCH("vdp_sprite_get_position", 100, vdp_sprite_get_position(sprite, x, y));
+    uint8_t attrs[4][4] = {{10, 20, 0, 15}, {10, 40, 0, 15}, {10, 60, 0, 15}, {10, 80, 0, 15}};
+    BENCH("vdp_sprite_write_table 4 sprites", 100, vdp_sprite_write_table(1, attrs[0], 4));
+    VdpSpriteTable table;
+    BENCH("VdpSpriteTable 32 sprites", 100, {
+        for (uint8_t s = 0; s < 32; s++)
+            table.set_position(s, i + s, 10 + s);
+        table.commit();
+    });
+    VdpSpriteMux<64> mux;
+    BENCH("VdpSpriteMux 64 sprites", 10, {
+        for (uint8_t s = 0; s < 64; s++)
+            mux.set_position(s, 4 * s + i, (s * 3 + i) % 192);
+        mux.commit();
+    });
+    BENCH("vdp_double_buffer on", 1, vdp_double_buffer(true));
+    BENCH("vdp_plot_hires buffered", 256, vdp_plot_hires(i, 20 + i / 64, VDP_WHITE));
+    BENCH("vdp_flush 256 pixels", 1, vdp_flush());
+    BENCH("vdp_flush 256 pixels no wait", 1, (vdp_plot_hires(0, 30, VDP_WHITE), vdp_plot_hires(255, 30, VDP_WHITE), vdp_flush(false)));
+    vdp_double_buffer(false);
+    BENCH("vdp_vblank_service on", 1, vdp_vblank_service(true));
+    uint8_t value = 0x55;
+    for (uint8_t i = 0; i < 6; i++)
+        vdp_queue(fillJob, &value, 258);
+    BENCH("vdp_service 6 jobs 256 bytes", 2, vdp_service());
+    vdp_vblank_service(false);
+    vdp_set_cursor(0, 0);
+    BENCH("vdp_write G2", 32, vdp_write('A'));
+    BENCH("Vdp<G2>::write", 32, Vdp<VDP_MODE_G2>::write(i, 1, 'A'));
+    BENCH("vdp_print G2 32 chars", 1, vdp_print("ABCDEFGHIJKLMNOPQRSTUVWXYZ012345"));
+    BENCH("vdp_print_P G2 32 chars", 1, vdp_print_P(PSTR("ABCDEFGHIJKLMNOPQRSTUVWXYZ012345")));
+    BENCH("vdp_printf G2 %5d %04X", 1, vdp_printf("%5d %04X", 12345, 0xBEEF));
+    BENCH("vdp_text G2 print(12345)", 1, vdp_text.print(12345));
+    vdp_set_cursor(0, 1);
+    BENCH("vdp_colorize", 32, (vdp_colorize(VDP_WHITE, VDP_DARK_BLUE), vdp_set_cursor(VDP_CSR_RIGHT)));
+    BENCH("vdp_set_pattern_color", 32, vdp_set_pattern_color(i, VDP_WHITE, VDP_DARK_BLUE));
+    BENCH("vdp_tile_cache on", 1, vdp_tile_cache(true));
+    vdp_set_cursor(0, 2);
+    BENCH("vdp_print G2 cache miss", 1, vdp_print("ABCDEFGHIJKLMNOPQRSTUVWXYZ012345"));
+    vdp_set_cursor(0, 3);
+    BENCH("vdp_print G2 cache hit", 1, vdp_print("ABCDEFGHIJKLMNOPQRSTUVWXYZ012345"));
+    vdp_tile_cache(false);
+    BENCH("vdp_load_g2_bitmap", 1, vdp_load_g2_bitmap(stripes));
+    uint16_t len = tmsImage(false);
+    BENCH("VdpTmsLoader 12k", 1, tmsLoad(len));
+    len = tmsImage(true);
+    BENCH("VdpTmsLoader RLE", 1, tmsLoad(len));
+    len = tmsStream();
+    BENCH("VdpStreamPlayer 10 frames", 1, streamPlay(len));
+    clearG2();
+    BENCH("line 200x40 per pixel", 1, plotLine(20, 100, 219, 139, VDP_WHITE));
+    clearG2();
+    BENCH("vdp_draw_line 200x40", 1, vdp_draw_line(20, 100, 219, 139, VDP_LIGHT_RED));
+    clearG2();
+    BENCH("rect 64x64 per pixel", 1, for (int16_t y = 0; y < 64; y++) for (int16_t x = 0; x < 64; x++) vdp_plot_hires(100 + x, 60 + y, VDP_WHITE));
+    clearG2();
+    BENCH("vdp_fill_rect 64x64", 1, vdp_fill_rect(100, 60, 64, 64, VDP_LIGHT_RED));
+    clearG2();
+    BENCH("circle r=40 per pixel", 1, plotCircle(128, 96, 40, VDP_WHITE));
+    clearG2();
+    BENCH("vdp_fill_circle r=40", 1, vdp_fill_circle(128, 96, 40, VDP_LIGHT_RED));
+    clearG2();
+    BENCH("vdp_draw_circle r=40", 1, vdp_draw_circle(128, 96, 40, VDP_WHITE));
+    static const int16_t star[] = {128, 20, 150, 80, 210, 80, 160, 115, 180, 175, 128, 140, 76, 175, 96, 115, 46, 80, 106, 80};
+    clearG2();
+    BENCH("vdp_fill_polygon star", 1, vdp_fill_polygon(star, 10, VDP_LIGHT_YELLOW));
+    static VdpG2Lowres<3> band;
+    band.begin();
+    BENCH("VdpG2Lowres<3> full screen", 1, {
+        for (uint8_t y = 0; y < 192; y += band.height())
+        {
+            band.select(y);
+            band.fill_rect(0, y, 64, 24, y >> 3);
+            band.blit();
+        }
+    });
+    static VdpConsole con;
+    con.begin();
+    con.set_auto_flush(false);
+    con.set_cursor(0, 23);
+    BENCH("VdpConsole G2 scroll 24 rows", 1, {
+        for (uint8_t r = 0; r < 24; r++)
+        {
+            con.println("ABCDEFGHIJKLMNOPQRSTUVWXYZ012345");
+            con.flush();
+        }
+    });
+
+    BENCH("vdp_init G1", 1, vdp_init_g1());
+    vdp_set_cursor(0, 0);
+    BENCH("vdp_print G1 32 chars", 1, vdp_print("ABCDEFGHIJKLMNOPQRSTUVWXYZ012345"));
+    BENCH("vdp_write G1", 32, vdp_write('A'));
+    BENCH("Vdp<G1>::write", 32, Vdp<VDP_MODE_G1>::write(i, 2, 'A'));
+    con.begin();
+    con.set_auto_flush(false);
+    con.set_cursor(0, 23);
+    BENCH("VdpConsole G1 scroll 24 rows", 1, {
+        for (uint8_t r = 0; r < 24; r++)
+        {
+            con.println("ABCDEFGHIJKLMNOPQRSTUVWXYZ012345");
+            con.flush();
+        }
+    });
+
+    BENCH("vdp_init Text", 1, vdp_init_textmode());
+    vdp_set_cursor(0, 0);
+    BENCH("vdp_print Text 40 chars", 1, vdp_print("ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789abcd"));
+    BENCH("vdp_textcolor Text", 1, vdp_textcolor(VDP_WHITE, VDP_DARK_BLUE));
+
+    BENCH("vdp_init Multicolor", 1, vdp_init_multicolor());
+    BENCH("vdp_plot_color MC", 64, vdp_plot_color(i, 10, VDP_WHITE));
+    BENCH("Vdp<MC>::plot_color", 64, Vdp<VDP_MODE_MULTICOLOR>::plot_color(i, 18, VDP_WHITE));
+    static VdpMulticolorFrame mc;
+    mc.fill(VDP_DARK_BLUE);
+    BENCH("VdpMulticolorFrame blit", 1, mc.blit());
+    BENCH("VdpMulticolorFrame blit vblank", 1, mc.blit(true));
+
+    // The diagnostics overwrite VRAM
+    VdpMarchResult march;
+    BENCH("vdp_diag_march 1 background", 1, vdp_diag_march(&march, 1));
+    VdpTiming timing;
+    BENCH("vdp_diag_timing", 1, vdp_diag_timing(timing));
+
+    printf("\r\n%-28s %10s %10s %10s %8s\r\n", "Full screen text", "ms", "chars/s", "VRAM/s", "violat.");
+    vdp_init_g2();
+    textRedraw("vdp_print G2", 32);
+    vdp_init_g1();
+    textRedraw("vdp_print G1", 32);
+    vdp_init_textmode();
+    textRedraw("vdp_print Text", 40);
+
+    printf("\r\n%-28s %10s %10s %10s %10s %8s\r\n", "Boot", "init ms", "warm ms", "init VRAM", "warm VRAM", "violat.");
+    bootTime("Graphics Mode 1", VDP_MODE_G1, 0xF1);
+    bootTime("Graphics Mode 2", VDP_MODE_G2, 0);
+    bootTime("Text", VDP_MODE_TEXT, 0xF1);
+    bootTime("Multicolor", VDP_MODE_MULTICOLOR, 0);
+
+    printf("\r\n%-28s %10s %10s %10s %10s %8s\r\n", "Workloads", "ms", "VRAM", "addr", "ctrl", "violat.");
+    vdp_init_g2();
+    workload("vdp_plot_hires full screen", hiresFill);
+    vdp_init_multicolor();
+    workload("vdp_plot_color MC full screen", multicolorFill);
+    vdp_init_g2();
+    workload("sprites 32 x 100 frames", spriteMovement);
+    vdp_init_g2();
+    workload("g2image load", imageLoad);
+
+    if (csv && !writeCsv(csv))
+    {
+        fprintf(stderr, "Error writing %s\r\n", csv);
+        return -1;
+    }
+    if (baseline)
+    {
+        int worse = compare(baseline, tolerance);
+        if (worse < 0)
+        {
+            fprintf(stderr, "Error reading %s\r\n", baseline);
+            return -1;
+        }
+        return worse ? 1 : 0;
+    }
+    return 0;
+}
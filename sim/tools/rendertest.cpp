@@ -0,0 +1,186 @@
+/* Golden image test of the renderer of the VDP simulator
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include "vdp_sim.h"
+#include "vdp_render.h"
+
+// VRAM and registers of a test screen. All tables are filled with pseudo random data, then the sprite attribute table
+// is set up with sprites that cover the special cases
+struct Setup
+{
+    const char *name;
+    uint8_t reg[8];
+    uint8_t sprites; // Number of sprites before the terminator
+};
+
+// Name table, color table, pattern table, sprite attribute table and sprite pattern table of vdp_init() in each mode,
+// and variations that exercise the table masks of Graphics Mode 2, the border of Text Mode and the sprite sizes
+static const Setup setups[] = {
+    {"g1", {0x00, 0xC0, 0x05, 0x80, 0x01, 0x20, 0x00, 0xF4}, 12},
+    {"g1 blank", {0x00, 0x80, 0x05, 0x80, 0x01, 0x20, 0x00, 0xF4}, 12},
+    {"g2", {0x02, 0xC0, 0x0E, 0xFF, 0x03, 0x76, 0x03, 0x05}, 12},
+    {"g2 masks", {0x02, 0xC0, 0x0E, 0x9F, 0x00, 0x76, 0x03, 0x05}, 12},
+    {"g2 16x16", {0x02, 0xC2, 0x0E, 0xFF, 0x03, 0x76, 0x03, 0x01}, 12},
+    {"g2 magnified", {0x02, 0xC1, 0x0E, 0xFF, 0x03, 0x76, 0x03, 0x01}, 12},
+    {"g2 16x16 magnified", {0x02, 0xC3, 0x0E, 0xFF, 0x03, 0x76, 0x03, 0x01}, 12},
+    {"g2 32 sprites", {0x02, 0xC2, 0x0E, 0xFF, 0x03, 0x76, 0x03, 0x01}, 32},
+    {"text", {0x00, 0xD0, 0x02, 0x00, 0x00, 0x00, 0x00, 0xF4}, 0},
+    {"multicolor", {0x00, 0xC8, 0x05, 0x00, 0x01, 0x76, 0x03, 0x0E}, 12},
+};
+
+static uint32_t lcg = 1;
+static uint8_t random8()
+{
+    lcg = lcg * 1103515245 + 12345;
+    return lcg >> 16;
+}
+
+static void setUp(const Setup &s)
+{
+    uint8_t *vram = vdp_sim_vram();
+    lcg = 1;
+    for (uint16_t i = 0; i < 0x4000; i++)
+        vram[i] = random8();
+    for (uint8_t r = 0; r < 8; r++)
+        vdp_sim_set_register(r, s.reg[r]);
+    if (s.reg[1] & 0x10) // Text mode has no sprites
+        return;
+    // 5 sprites on the lines 40 - 47 set the 5th sprite flag, 0 and 1 overlap for the coincidence flag,
+    // sprite 6 uses the early clock, the transparent sprite 9 overlaps sprite 10, which shows through,
+    // 7 and 8 are partly outside the screen
+    static const uint8_t sat[12][4] = {
+        {39, 20, 0, 0x0F}, {39, 24, 1, 0x08}, {39, 60, 2, 0x02}, {39, 100, 3, 0x04}, {39, 140, 4, 0x0A},
+        {100, 200, 5, 0x0D}, {100, 10, 6, 0x87}, {0xF8, 80, 7, 0x0B}, {185, 250, 8, 0x06}, {118, 124, 9, 0x00},
+        {120, 128, 10, 0x09}, {60, 30, 11, 0x03}};
+    uint8_t *table = vram + ((s.reg[5] & 0x7F) << 7);
+    for (uint8_t i = 0; i < s.sprites; i++)
+    {
+        if (i < 12)
+            memcpy(table + 4 * i, sat[i], 4);
+        else
+        {
+            uint8_t attrs[4] = {(uint8_t)(8 * i), (uint8_t)(7 * i), i, (uint8_t)(i % 15 + 1)};
+            memcpy(table + 4 * i, attrs, 4);
+        }
+    }
+    if (s.sprites < 32)
+        table[4 * s.sprites] = 0xD0;
+}
+
+// FNV-1a of the frame and the sprite flags
+static uint32_t hash(const VdpFrame &frame, uint8_t status)
+{
+    uint32_t h = 2166136261u;
+    const uint8_t *p = &frame[0][0];
+    for (size_t i = 0; i < sizeof(VdpFrame); i++)
+        h = (h ^ p[i]) * 16777619u;
+    return (h ^ status) * 16777619u;
+}
+
+int main(int argc, const char *argv[])
+{
+    const char *golden = NULL, *dir = NULL;
+    bool update = false;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--update"))
+            update = true;
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            dir = argv[++i];
+        else
+            golden = argv[i];
+    }
+    if (!golden)
+    {
+        fprintf(stderr, "Usage: rendertest golden.txt [--update] [-o directory]\r\n");
+        fprintf(stderr, "Renders test screens of all modes and compares them with the hashes in golden.txt\r\n");
+        fprintf(stderr, "--update: Write the hashes of the current renderer to golden.txt\r\n");
+        fprintf(stderr, "-o: Save the screens as PPM files\r\n");
+        return -1;
+    }
+
+    std::vector<std::string> names;
+    std::vector<uint32_t> hashes;
+    FILE *f = fopen(golden, "r");
+    char line[80];
+    while (f && fgets(line, sizeof(line), f))
+    {
+        char *sep = strrchr(line, ' ');
+        if (!sep)
+            continue;
+        *sep = 0;
+        names.push_back(line);
+        hashes.push_back(strtoul(sep + 1, NULL, 16));
+    }
+    if (f)
+        fclose(f);
+    if (!f && !update)
+    {
+        fprintf(stderr, "Error reading %s\r\n", golden);
+        return -1;
+    }
+
+    vdp_sim_power_on();
+    static VdpFrame frame;
+    std::string out;
+    int failed = 0;
+    for (const Setup &s : setups)
+    {
+        setUp(s);
+        uint8_t status = vdp_render(frame);
+        uint32_t h = hash(frame, status);
+        char entry[80];
+        snprintf(entry, sizeof(entry), "%s %08x\n", s.name, h);
+        out += entry;
+        if (dir)
+        {
+            std::string file = std::string(dir) + "/" + s.name + ".ppm";
+            for (size_t i = strlen(dir) + 1; i < file.size(); i++)
+                if (file[i] == ' ')
+                    file[i] = '_';
+            vdp_render_write_ppm(frame, file.c_str());
+        }
+        if (update)
+            continue;
+        size_t i = 0;
+        while (i < names.size() && names[i] != s.name)
+            i++;
+        if (i == names.size())
+            printf("%-20s no golden hash\r\n", s.name);
+        else if (hashes[i] != h)
+            printf("%-20s %08x, expected %08x\r\n", s.name, h, hashes[i]);
+        else
+            continue;
+        failed++;
+    }
+    if (update)
+    {
+        f = fopen(golden, "w");
+        if (!f || fputs(out.c_str(), f) < 0 || fclose(f))
+        {
+            fprintf(stderr, "Error writing %s\r\n", golden);
+            return -1;
+        }
+        printf("%d hashes written to %s\r\n", (int)(sizeof(setups) / sizeof(setups[0])), golden);
+        return 0;
+    }
+    printf("%d of %d screens differ\r\n", failed, (int)(sizeof(setups) / sizeof(setups[0])));
+    return failed ? 1 : 0;
+}
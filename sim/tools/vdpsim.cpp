@@ -0,0 +1,196 @@
+/* Runs the examples of the TMS9918 Arduino library on the VDP simulator
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <Arduino.h>
+#include "vdp_render.h"
+#include "vdp_instrument.h"
+#include "../../examples/examples.h"
+
+void serialEvent();
+
+struct Example
+{
+    const char *name;
+    void (*run)();
+};
+
+static const Example examples[] = {
+    {"textmode", textmode},
+    {"g1text", g1text},
+    {"g2text", g2text},
+    {"sprites", sprites},
+    {"g2image", g2image},
+    {"console", console},
+    {"diag", diag},
+};
+
+static void print_stats(const char *name, const VdpSimStats &s)
+{
+    fprintf(stderr, "%s: %.1f ms, %llu cycles\r\n", name, s.cycles / (VDP_SIM_F_CPU / 1000.0), (unsigned long long)s.cycles);
+    fprintf(stderr, "  VRAM writes %u, VRAM reads %u, control writes %u, status reads %u\r\n",
+            s.vram_writes, s.vram_reads, s.ctrl_writes, s.status_reads);
+    fprintf(stderr, "  Address setups %u, register writes %u, bus conflicts %u, access violations %u\r\n",
+            s.address_setups, s.register_writes, s.bus_conflicts, s.access_violations);
+}
+
+// Counters of vdp_instrument.h go to stderr, next to the statistics
+class StderrPrint : public Print
+{
+public:
+    size_t write(uint8_t c) override { return fputc(c, stderr) != EOF; }
+    using Print::write;
+};
+
+// Renders the final screen n times and reports the frame rate of the renderer
+static void bench_render(int n)
+{
+    static VdpFrame frame;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++)
+        vdp_render(frame);
+    std::chrono::duration<double> t = std::chrono::steady_clock::now() - start;
+    fprintf(stderr, "Renderer: %d frames in %.3f s, %.0f frames/s\r\n", n, t.count(), n / t.count());
+}
+
+// Pseudo terminal for the Serial of the sketch, imgserial can send to it like to an Arduino. Returns the master side
+static int open_pty()
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) || unlockpt(master))
+        return -1;
+    // Keep the slave side open, otherwise the master reports a hangup until imgserial opens it
+    int slave = open(ptsname(master), O_RDWR | O_NOCTTY);
+    termios tty;
+    if (slave < 0 || tcgetattr(slave, &tty))
+        return -1;
+    cfmakeraw(&tty);
+    tcsetattr(slave, TCSANOW, &tty);
+    fprintf(stderr, "Serial port: %s\r\n", ptsname(master));
+    return master;
+}
+
+int main(int argc, const char *argv[])
+{
+    const Example *example = NULL;
+    const char *ppm = NULL;
+    uint32_t ms = 2000;
+    int frames = 0, idle = 0, errors = 0, data_valid = 0;
+    bool pty = false;
+    struct
+    {
+        unsigned a, b, c;
+    } stuck[VDP_SIM_FAULTS], coupling[VDP_SIM_FAULTS];
+    int n_stuck = 0, n_coupling = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        if (!strcmp(argv[i], "--ms") && i + 1 < argc)
+            ms = atol(argv[++i]);
+        else if (!strcmp(argv[i], "-o") && i + 1 < argc)
+            ppm = argv[++i];
+        else if (!strcmp(argv[i], "--bench-render") && i + 1 < argc)
+            frames = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--pty"))
+            pty = true;
+        else if (!strcmp(argv[i], "--idle") && i + 1 < argc)
+            idle = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--serial-errors") && i + 1 < argc)
+            errors = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--fault-stuck") && i + 1 < argc && n_stuck < VDP_SIM_FAULTS)
+            n_stuck += sscanf(argv[++i], "%i:%i:%i", &stuck[n_stuck].a, &stuck[n_stuck].b, &stuck[n_stuck].c) == 3;
+        else if (!strcmp(argv[i], "--fault-coupling") && i + 1 < argc && n_coupling < VDP_SIM_FAULTS)
+            n_coupling += sscanf(argv[++i], "%i:%i:%i", &coupling[n_coupling].a, &coupling[n_coupling].b, &coupling[n_coupling].c) == 3;
+        else if (!strcmp(argv[i], "--fault-timing") && i + 1 < argc)
+            data_valid = atoi(argv[++i]);
+        else
+            for (const Example &e : examples)
+                if (!strcmp(argv[i], e.name))
+                    example = &e;
+    }
+    if (!example)
+    {
+        fprintf(stderr, "Runs an example sketch on the VDP simulator\r\n");
+        fprintf(stderr, "\r\nUsage: vdpsim example [--ms time_limit] [-o screen.ppm] [--bench-render frames] [--pty [--idle ms]] [--serial-errors n]\r\n");
+        fprintf(stderr, "       [--fault-stuck address:mask:value] [--fault-coupling aggressor:victim:mask] [--fault-timing cycles]\r\n");
+        fprintf(stderr, "Examples: textmode g1text g2text sprites g2image console diag\r\n");
+        fprintf(stderr, "g2image reads the data sent by imgserial from stdin: vdpsim g2image < image.bin\r\n");
+        fprintf(stderr, "--pty: Serial is a pseudo terminal, imgserial can send to it. vdpsim ends after --idle ms (default 5000) without data\r\n");
+        fprintf(stderr, "--serial-errors n: Flip a bit in every nth byte received by the sketch\r\n");
+        fprintf(stderr, "--fault-stuck, --fault-coupling, --fault-timing: Inject VRAM and bus faults, see vdp_sim.h. For the diag example\r\n");
+        return -1;
+    }
+    if (pty)
+    {
+        int fd = open_pty();
+        if (fd < 0)
+        {
+            fprintf(stderr, "Error opening pseudo terminal\r\n");
+            return -1;
+        }
+        Serial.attach(fd, fd);
+        if (!idle)
+            idle = 5000;
+    }
+    Serial.inject_errors(errors);
+
+    vdp_sim_power_on();
+    for (int i = 0; i < n_stuck; i++)
+        vdp_sim_fault_stuck(stuck[i].a, stuck[i].b, stuck[i].c);
+    for (int i = 0; i < n_coupling; i++)
+        vdp_sim_fault_coupling(coupling[i].a, coupling[i].b, coupling[i].c);
+    vdp_sim_fault_timing(data_valid);
+    vdp_sim_set_time_limit(ms);
+    try
+    {
+        example->run();
+        while (example->run == g2image)
+        {
+            pollfd p = {Serial.fd(), POLLIN, 0};
+            if (Serial.available())
+                serialEvent();
+            else if (!idle || poll(&p, 1, idle) <= 0)
+                break;
+        }
+    }
+    catch (VdpSimTimeout &)
+    {
+        fprintf(stderr, "Time limit of %u ms reached\r\n", ms);
+    }
+    print_stats(example->name, vdp_sim_stats());
+#ifdef VDP_INSTRUMENT
+    StderrPrint err;
+    vdp_instrument_dump(err);
+#endif
+    if (ppm)
+    {
+        static VdpFrame frame;
+        vdp_render(frame);
+        if (!vdp_render_write_ppm(frame, ppm))
+        {
+            fprintf(stderr, "Error writing %s\r\n", ppm);
+            return -1;
+        }
+    }
+    if (frames)
+        bench_render(frames);
+    return 0;
+}
@@ -0,0 +1,263 @@
+/* Software renderer for the VDP simulator
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdio.h>
+#include <string.h>
+#include "vdp_sim.h"
+#include "vdp_render.h"
+
+#define R0_M3 0x02
+#define R1_BLANK 0x40
+#define R1_M1 0x10
+#define R1_M2 0x08
+#define R1_SIZE 0x02
+#define R1_MAG 0x01
+#define FLAG_S5 0x40
+#define FLAG_COIN 0x20
+
+const uint8_t vdp_palette[16][3] = {
+    {0, 0, 0}, {0, 0, 0}, {33, 200, 66}, {94, 220, 120},
+    {84, 85, 237}, {125, 118, 252}, {212, 82, 77}, {66, 235, 245},
+    {252, 85, 84}, {255, 121, 120}, {212, 193, 84}, {230, 206, 128},
+    {33, 176, 59}, {201, 91, 186}, {204, 204, 204}, {255, 255, 255}};
+
+// Expands a pattern byte to 8 byte masks, first pixel in the lowest byte
+static uint64_t expand[256];
+static const uint64_t ONES = 0x0101010101010101ULL;
+
+static void init_tables()
+{
+    if (expand[0xFF])
+        return;
+    for (int p = 0; p < 256; p++)
+        for (int b = 0; b < 8; b++)
+            if (p & (0x80 >> b))
+                expand[p] |= 0xFFULL << (8 * b);
+}
+
+// Draws 8 pixels of pattern byte p with the colors fg and bg in one 64 bit operation
+static inline void span8(uint8_t *dst, uint8_t p, uint8_t fg, uint8_t bg)
+{
+    uint64_t m = expand[p];
+    uint64_t v = ((fg * ONES) & m) | ((bg * ONES) & ~m);
+    memcpy(dst, &v, 8);
+}
+
+// Resolves transparent colors to the backdrop
+static uint8_t resolve[16][16];
+
+static void init_resolve(uint8_t backdrop)
+{
+    for (int c = 0; c < 16; c++)
+        resolve[backdrop][c] = c ? c : backdrop;
+}
+
+static void render_g1(VdpFrame &frame, const uint8_t *vram, const uint8_t *reg, uint8_t bd)
+{
+    const uint8_t *name = vram + ((reg[2] & 0x0F) << 10);
+    const uint8_t *color = vram + (reg[3] << 6);
+    const uint8_t *pattern = vram + ((reg[4] & 0x07) << 11);
+    for (int y = 0; y < VDP_RENDER_HEIGHT; y++)
+    {
+        const uint8_t *row = name + (y >> 3) * 32;
+        for (int col = 0; col < 32; col++)
+        {
+            uint8_t n = row[col];
+            uint8_t c = color[n >> 3];
+            span8(&frame[y][col * 8], pattern[n * 8 + (y & 7)], resolve[bd][c >> 4], resolve[bd][c & 0x0F]);
+        }
+    }
+}
+
+static void render_g2(VdpFrame &frame, const uint8_t *vram, const uint8_t *reg, uint8_t bd)
+{
+    const uint8_t *name = vram + ((reg[2] & 0x0F) << 10);
+    uint16_t color_base = (reg[3] & 0x80) << 6;
+    uint16_t color_mask = ((reg[3] & 0x7F) << 6) | 0x3F;
+    uint16_t pattern_base = (reg[4] & 0x04) << 11;
+    uint16_t pattern_mask = ((reg[4] & 0x03) << 11) | 0x7FF;
+    for (int y = 0; y < VDP_RENDER_HEIGHT; y++)
+    {
+        const uint8_t *row = name + (y >> 3) * 32;
+        uint16_t third = (y >> 6) << 8;
+        for (int col = 0; col < 32; col++)
+        {
+            uint16_t offset = ((third | row[col]) << 3) | (y & 7);
+            uint8_t c = vram[color_base | (offset & color_mask)];
+            uint8_t p = vram[pattern_base | (offset & pattern_mask)];
+            span8(&frame[y][col * 8], p, resolve[bd][c >> 4], resolve[bd][c & 0x0F]);
+        }
+    }
+}
+
+static void render_multicolor(VdpFrame &frame, const uint8_t *vram, const uint8_t *reg, uint8_t bd)
+{
+    const uint8_t *name = vram + ((reg[2] & 0x0F) << 10);
+    const uint8_t *pattern = vram + ((reg[4] & 0x07) << 11);
+    for (int y = 0; y < VDP_RENDER_HEIGHT; y++)
+    {
+        const uint8_t *row = name + (y >> 3) * 32;
+        uint8_t line = ((y >> 3) & 3) * 2 + ((y & 7) >> 2);
+        for (int col = 0; col < 32; col++)
+        {
+            uint8_t c = pattern[row[col] * 8 + line];
+            span8(&frame[y][col * 8], 0xF0, resolve[bd][c >> 4], resolve[bd][c & 0x0F]);
+        }
+    }
+}
+
+static void render_text(VdpFrame &frame, const uint8_t *vram, const uint8_t *reg, uint8_t bd)
+{
+    const uint8_t *name = vram + ((reg[2] & 0x0F) << 10);
+    const uint8_t *pattern = vram + ((reg[4] & 0x07) << 11);
+    uint8_t fg = resolve[bd][reg[7] >> 4];
+    for (int y = 0; y < VDP_RENDER_HEIGHT; y++)
+    {
+        const uint8_t *row = name + (y >> 3) * 40;
+        uint8_t *dst = &frame[y][0];
+        memset(dst, bd, 8);
+        memset(dst + 248, bd, 8);
+        for (int col = 0; col < 40; col++)
+        {
+            uint8_t px[8];
+            span8(px, pattern[row[col] * 8 + (y & 7)], fg, bd);
+            memcpy(dst + 8 + col * 6, px, 6);
+        }
+    }
+}
+
+// Evaluates and optionally draws the sprites, returns the sprite flags of the status register
+static uint8_t render_sprites(VdpFrame *frame, const uint8_t *vram, const uint8_t *reg)
+{
+    const uint8_t *sat = vram + ((reg[5] & 0x7F) << 7);
+    const uint8_t *spg = vram + ((reg[6] & 0x07) << 11);
+    uint8_t size = reg[1] & R1_SIZE ? 16 : 8;
+    uint8_t mag = reg[1] & R1_MAG;
+    int height = size << mag;
+    uint8_t flags = 0;
+    uint8_t last = 31;
+    for (int i = 0; i < 32; i++)
+        if (sat[i * 4] == 0xD0)
+        {
+            last = i;
+            break;
+        }
+    uint8_t fifth = last;
+
+    for (int line = 0; line < VDP_RENDER_HEIGHT; line++)
+    {
+        // Pixels of sprites with higher priority: Any pixel for the coincidence flag, opaque ones hide lower sprites
+        uint8_t collide[VDP_RENDER_WIDTH + 32] = {0};
+        uint8_t drawn[VDP_RENDER_WIDTH + 32] = {0};
+        int on_line = 0;
+        for (int i = 0; i < 32; i++)
+        {
+            const uint8_t *a = sat + i * 4;
+            if (a[0] == 0xD0)
+                break;
+            int top = (a[0] >= 0xE1 ? a[0] - 256 : a[0]) + 1;
+            if (line < top || line >= top + height)
+                continue;
+            if (++on_line > 4)
+            {
+                if (!(flags & FLAG_S5))
+                {
+                    flags |= FLAG_S5;
+                    fifth = i;
+                }
+                break;
+            }
+            int x = a[1] - (a[3] & 0x80 ? 32 : 0);
+            uint8_t name = size == 16 ? a[2] & 0xFC : a[2];
+            uint8_t color = a[3] & 0x0F;
+            int row = (line - top) >> mag;
+            for (int px = 0; px < (size << mag); px++)
+            {
+                int sx = x + px;
+                if (sx < 0 || sx >= VDP_RENDER_WIDTH)
+                    continue;
+                int col = px >> mag;
+                uint8_t bits = spg[name * 8 + (col >> 3) * 16 + row];
+                if (!(bits & (0x80 >> (col & 7))))
+                    continue;
+                if (collide[sx])
+                    flags |= FLAG_COIN;
+                collide[sx] = 1;
+                if (!color || drawn[sx]) // Transparent sprites count for coincidence and the 4 sprites per line only
+                    continue;
+                drawn[sx] = 1;
+                if (frame)
+                    (*frame)[line][sx] = color;
+            }
+        }
+    }
+    return flags | fifth;
+}
+
+uint8_t vdp_render(VdpFrame &frame)
+{
+    init_tables();
+    uint8_t reg[8];
+    for (int i = 0; i < 8; i++)
+        reg[i] = vdp_sim_register(i);
+    const uint8_t *vram = vdp_sim_vram();
+    uint8_t bd = reg[7] & 0x0F;
+    init_resolve(bd);
+
+    if (!(reg[1] & R1_BLANK))
+    {
+        memset(frame, bd, sizeof(VdpFrame));
+        return 0;
+    }
+    if (reg[1] & R1_M1)
+    {
+        render_text(frame, vram, reg, bd);
+        return 0; // No sprites in text mode
+    }
+    if (reg[1] & R1_M2)
+        render_multicolor(frame, vram, reg, bd);
+    else if (reg[0] & R0_M3)
+        render_g2(frame, vram, reg, bd);
+    else
+        render_g1(frame, vram, reg, bd);
+    return render_sprites(&frame, vram, reg);
+}
+
+uint8_t vdp_render_sprite_status()
+{
+    uint8_t reg[8];
+    for (int i = 0; i < 8; i++)
+        reg[i] = vdp_sim_register(i);
+    if (!(reg[1] & R1_BLANK) || (reg[1] & R1_M1))
+        return 0;
+    return render_sprites(NULL, vdp_sim_vram(), reg);
+}
+
+bool vdp_render_write_ppm(const VdpFrame &frame, const char *filename)
+{
+    FILE *f = fopen(filename, "wb");
+    if (!f)
+        return false;
+    fprintf(f, "P6\n%d %d\n255\n", VDP_RENDER_WIDTH, VDP_RENDER_HEIGHT);
+    for (int y = 0; y < VDP_RENDER_HEIGHT; y++)
+    {
+        uint8_t rgb[VDP_RENDER_WIDTH * 3];
+        for (int x = 0; x < VDP_RENDER_WIDTH; x++)
+            memcpy(&rgb[x * 3], vdp_palette[frame[y][x] & 0x0F], 3);
+        fwrite(rgb, 1, sizeof(rgb), f);
+    }
+    return fclose(f) == 0;
+}
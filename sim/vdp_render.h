@@ -0,0 +1,54 @@
+/**
+ * @file vdp_render.h
+ * @author Doctor Volt
+ * @brief Software renderer for the VDP simulator. Turns the simulated VRAM into 256x192 frames.
+ *
+ * Supports Graphics Mode 1, Graphics Mode 2, Multicolor Mode and Text Mode as programmed by the registers,
+ * including the sprite rules of the TMS9918: 4 sprites per line, 5th sprite and coincidence flags, early clock,
+ * 16x16 and magnified sprites.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_RENDER_H
+#define VDP_RENDER_H
+#include <stdint.h>
+
+#define VDP_RENDER_WIDTH 256
+#define VDP_RENDER_HEIGHT 192
+
+/**
+ * @brief Framebuffer of palette indices 1..15 (VDP_COLORS). Transparent pixels show the backdrop color.
+ */
+typedef uint8_t VdpFrame[VDP_RENDER_HEIGHT][VDP_RENDER_WIDTH];
+
+/**
+ * @brief RGB values of the 16 colors, same as imgserial/tms9918.gpl
+ */
+extern const uint8_t vdp_palette[16][3];
+
+/**
+ * @brief Render the current content of the simulated VRAM
+ *
+ * @param frame Framebuffer to render into
+ * @return Sprite flags of the status register: VDP_FLAG_S5 | VDP_FLAG_COIN | number of 5th sprite
+ */
+uint8_t vdp_render(VdpFrame &frame);
+
+/**
+ * @brief Evaluate the sprites only, as the VDP does while it draws a frame
+ *
+ * @return Sprite flags of the status register: VDP_FLAG_S5 | VDP_FLAG_COIN | number of 5th sprite
+ */
+uint8_t vdp_render_sprite_status();
+
+/**
+ * @brief Write the frame as binary PPM (P6) file
+ *
+ * @param frame
+ * @param filename
+ * @return true on success
+ */
+bool vdp_render_write_ppm(const VdpFrame &frame, const char *filename);
+
+#endif
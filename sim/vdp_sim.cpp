@@ -0,0 +1,387 @@
+/* Host side model of the TMS9918 for the TMS9918 Arduino library
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include "vdp_sim.h"
+#include "vdp_render.h"
+
+#define STATUS_F 0x80
+#define STATUS_S5 0x40
+#define STATUS_COIN 0x20
+#define R1_IE 0x20
+
+static struct
+{
+    uint8_t vram[0x4000];
+    uint8_t reg[8];
+    uint8_t status;
+    uint16_t addr;
+    uint8_t read_ahead; // Read ahead buffer of the data port
+    uint8_t latch;      // First byte written to the control port
+    bool latched;       // true: Next control port write is the second byte
+} vdp;
+
+static struct
+{
+    uint8_t mode = 1, csw = 1, csr = 1, reset = 1;
+    bool output;    // Data bus direction of the AVR
+    uint8_t out;    // Value driven by the AVR
+    uint8_t driven; // Value driven by the VDP while CSR is low
+} bus;
+
+static VdpSimStats stats;
+static uint64_t clock_;
+static uint64_t next_frame = VDP_SIM_FRAME_CYCLES;
+static uint64_t time_limit;
+static uint64_t last_access; // Clock of the last VRAM access of the CPU
+static void (*int_handler)();
+static bool int_low;
+static uint64_t csr_fall; // Clock of the last falling edge of CSR
+
+static struct
+{
+    struct
+    {
+        uint16_t address;
+        uint8_t mask, value;
+    } stuck[VDP_SIM_FAULTS];
+    struct
+    {
+        uint16_t aggressor, victim;
+        uint8_t mask;
+    } coupling[VDP_SIM_FAULTS];
+    uint8_t n_stuck, n_coupling;
+    uint8_t data_valid; // 0: No timing faults
+} faults;
+
+static uint8_t stuck_bits(uint16_t address, uint8_t value)
+{
+    for (uint8_t i = 0; i < faults.n_stuck; i++)
+        if (faults.stuck[i].address == address)
+            value = (value & ~faults.stuck[i].mask) | (faults.stuck[i].value & faults.stuck[i].mask);
+    return value;
+}
+
+// Write a byte to the VRAM array, through the injected faults
+static void vram_store(uint16_t address, uint8_t value)
+{
+    uint8_t old = vdp.vram[address];
+    vdp.vram[address] = value = stuck_bits(address, value);
+    for (uint8_t i = 0; i < faults.n_coupling; i++)
+        if (faults.coupling[i].aggressor == address && ((old ^ value) & faults.coupling[i].mask))
+        {
+            uint16_t victim = faults.coupling[i].victim;
+            vdp.vram[victim] = stuck_bits(victim, vdp.vram[victim] ^ faults.coupling[i].mask);
+        }
+}
+
+// INT is low while the frame flag and the interrupt enable bit are set
+static void update_int()
+{
+    bool low = (vdp.status & STATUS_F) && (vdp.reg[1] & R1_IE);
+    bool falling = low && !int_low;
+    int_low = low;
+    if (falling && int_handler)
+        int_handler();
+}
+
+// The VDP gives the CPU a slot to access VRAM only every 8us while it draws the screen.
+// Returns false if the access fails with timing faults injected
+static bool vram_access()
+{
+    bool blank = !(vdp.reg[1] & 0x40) || clock_ + VDP_SIM_FRAME_CYCLES - next_frame < VDP_SIM_VBLANK_CYCLES;
+    bool violation = clock_ - last_access < (blank ? VDP_SIM_ACCESS_CYCLES_BLANK : VDP_SIM_ACCESS_CYCLES);
+    if (violation)
+        stats.access_violations++;
+    last_access = clock_;
+    return !(violation && faults.data_valid);
+}
+
+static void control_write(uint8_t value)
+{
+    stats.ctrl_writes++;
+    if (!vdp.latched)
+    {
+        vdp.latch = value;
+        vdp.latched = true;
+        return;
+    }
+    vdp.latched = false;
+    if (value & 0x80) // Register write
+    {
+        vdp.reg[value & 0x07] = vdp.latch;
+        stats.register_writes++;
+        update_int();
+        return;
+    }
+    vdp.addr = ((value & 0x3F) << 8) | vdp.latch;
+    stats.address_setups++;
+    if (!(value & 0x40)) // Read setup prefetches the first byte, in the next access slot
+    {
+        vdp.read_ahead = vram_access() ? vdp.vram[vdp.addr] : 0xFF;
+        vdp.addr = (vdp.addr + 1) & 0x3FFF;
+    }
+}
+
+static void data_write(uint8_t value)
+{
+    stats.vram_writes++;
+    bool ok = vram_access();
+    vdp.latched = false;
+    if (ok)
+        vram_store(vdp.addr, value);
+    vdp.read_ahead = value;
+    vdp.addr = (vdp.addr + 1) & 0x3FFF;
+}
+
+static void strobe_write()
+{
+    if (!bus.output)
+        stats.bus_conflicts++;
+    uint8_t value = bus.output ? bus.out : 0xFF;
+    if (bus.mode)
+        control_write(value);
+    else
+        data_write(value);
+}
+
+static void strobe_read_begin()
+{
+    if (bus.output)
+        stats.bus_conflicts++;
+    if (bus.mode)
+    {
+        stats.status_reads++;
+        bus.driven = vdp.status;
+    }
+    else
+    {
+        stats.vram_reads++;
+        bus.driven = vram_access() ? vdp.read_ahead : 0xFF;
+    }
+}
+
+static void strobe_read_end()
+{
+    vdp.latched = false;
+    if (bus.mode)
+    {
+        vdp.status &= 0x1F; // Reading clears F, 5S and C
+        update_int();
+    }
+    else
+    {
+        vdp.read_ahead = vdp.vram[vdp.addr];
+        vdp.addr = (vdp.addr + 1) & 0x3FFF;
+    }
+}
+
+// Sprite flags are updated once per frame, as the VDP draws the screen
+static void end_of_frame()
+{
+    uint8_t sprites = vdp_render_sprite_status();
+    vdp.status |= STATUS_F | (sprites & STATUS_COIN);
+    if (!(vdp.status & STATUS_S5)) // 5S and the sprite number are held until the status is read
+        vdp.status = (vdp.status & (STATUS_F | STATUS_COIN)) | (sprites & ~STATUS_COIN);
+    update_int();
+}
+
+static void reset_vdp()
+{
+    memset(vdp.reg, 0, sizeof(vdp.reg));
+    vdp.status = 0;
+    vdp.latched = false;
+    update_int();
+}
+
+void vdp_sim_pin(uint8_t pin, uint8_t level)
+{
+    level = level ? 1 : 0;
+    switch (pin)
+    {
+    case VDP_SIM_PIN_MODE:
+        bus.mode = level;
+        break;
+    case VDP_SIM_PIN_CSW:
+        if (!bus.csw && level)
+            strobe_write();
+        bus.csw = level;
+        break;
+    case VDP_SIM_PIN_CSR:
+        if (bus.csr && !level)
+        {
+            csr_fall = clock_;
+            strobe_read_begin();
+        }
+        else if (!bus.csr && level)
+            strobe_read_end();
+        bus.csr = level;
+        break;
+    case VDP_SIM_PIN_RESET:
+        if (!level)
+            reset_vdp();
+        bus.reset = level;
+        break;
+    }
+}
+
+void vdp_sim_bus_dir(bool output)
+{
+    bus.output = output;
+}
+
+void vdp_sim_bus_write(uint8_t value)
+{
+    bus.out = value;
+}
+
+uint8_t vdp_sim_bus_read()
+{
+    if (bus.output || bus.csr)
+        return 0xFF; // Nobody drives the bus
+    if (clock_ - csr_fall < faults.data_valid)
+        return 0xFF; // Not yet
+    return bus.driven;
+}
+
+void vdp_sim_cycles(uint32_t n)
+{
+    uint64_t end = clock_ + n;
+    stats.cycles += n;
+    while (end >= next_frame) // Every frame ends at its time, also within a long delay()
+    {
+        clock_ = next_frame;
+        next_frame += VDP_SIM_FRAME_CYCLES;
+        end_of_frame();
+    }
+    clock_ = end;
+    if (time_limit && clock_ > time_limit)
+        throw VdpSimTimeout();
+}
+
+void vdp_sim_power_on()
+{
+    srand(9918);
+    for (uint16_t i = 0; i < sizeof(vdp.vram); i++)
+        vdp.vram[i] = stuck_bits(i, rand());
+    for (uint8_t i = 0; i < 8; i++)
+        vdp.reg[i] = rand();
+    vdp.status = 0;
+    vdp.addr = 0;
+    vdp.latched = false;
+    clock_ = 0;
+    last_access = 0;
+    next_frame = VDP_SIM_FRAME_CYCLES;
+    stats = VdpSimStats();
+    int_low = false;
+}
+
+void vdp_sim_set_time_limit(uint32_t ms)
+{
+    time_limit = ms ? clock_ + (uint64_t)ms * (VDP_SIM_F_CPU / 1000) : 0;
+}
+
+VdpSimStats vdp_sim_stats()
+{
+    return stats;
+}
+
+void vdp_sim_reset_stats()
+{
+    stats = VdpSimStats();
+}
+
+VdpSimStats vdp_sim_diff(const VdpSimStats &after, const VdpSimStats &before)
+{
+    VdpSimStats d;
+    d.cycles = after.cycles - before.cycles;
+    d.vram_writes = after.vram_writes - before.vram_writes;
+    d.vram_reads = after.vram_reads - before.vram_reads;
+    d.ctrl_writes = after.ctrl_writes - before.ctrl_writes;
+    d.status_reads = after.status_reads - before.status_reads;
+    d.address_setups = after.address_setups - before.address_setups;
+    d.register_writes = after.register_writes - before.register_writes;
+    d.bus_conflicts = after.bus_conflicts - before.bus_conflicts;
+    d.access_violations = after.access_violations - before.access_violations;
+    return d;
+}
+
+uint64_t vdp_sim_clock()
+{
+    return clock_;
+}
+
+void vdp_sim_attach_int(void (*handler)())
+{
+    int_handler = handler;
+}
+
+uint8_t vdp_sim_int()
+{
+    return int_low ? 0 : 1;
+}
+
+void vdp_sim_fault_stuck(uint16_t address, uint8_t mask, uint8_t value)
+{
+    if (faults.n_stuck == VDP_SIM_FAULTS)
+        return;
+    faults.stuck[faults.n_stuck++] = {(uint16_t)(address & 0x3FFF), mask, value};
+    vdp.vram[address & 0x3FFF] = stuck_bits(address & 0x3FFF, vdp.vram[address & 0x3FFF]);
+}
+
+void vdp_sim_fault_coupling(uint16_t aggressor, uint16_t victim, uint8_t mask)
+{
+    if (faults.n_coupling < VDP_SIM_FAULTS)
+        faults.coupling[faults.n_coupling++] = {(uint16_t)(aggressor & 0x3FFF), (uint16_t)(victim & 0x3FFF), mask};
+}
+
+void vdp_sim_fault_timing(uint8_t data_valid)
+{
+    faults.data_valid = data_valid;
+}
+
+void vdp_sim_fault_clear()
+{
+    faults.n_stuck = faults.n_coupling = 0;
+    faults.data_valid = 0;
+}
+
+uint8_t *vdp_sim_vram()
+{
+    return vdp.vram;
+}
+
+uint8_t vdp_sim_register(uint8_t reg)
+{
+    return vdp.reg[reg & 7];
+}
+
+void vdp_sim_set_register(uint8_t reg, uint8_t value)
+{
+    vdp.reg[reg & 7] = value;
+    update_int();
+}
+
+uint8_t vdp_sim_status()
+{
+    return vdp.status;
+}
+
+uint16_t vdp_sim_address()
+{
+    return vdp.addr;
+}
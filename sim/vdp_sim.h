@@ -0,0 +1,150 @@
+/**
+ * @file vdp_sim.h
+ * @author Doctor Volt
+ * @brief Host side model of the TMS9918 and its bus, wired as in the schematic
+ *
+ * The simulator replaces the Core IO functions of tms9918.cpp when the library is compiled with -DVDP_SIM.
+ * It models the 16k VRAM, the 8 write only registers, the status register and the two byte address latch of the
+ * control port. Every bus transaction is counted and the time the AVR would spend on it is accounted in CPU cycles of
+ * a 16 MHz ATmega328.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_SIM_H
+#define VDP_SIM_H
+#include <stdint.h>
+
+/**
+ * @brief Arduino pins the VDP is wired to (see schematic)
+ */
+#define VDP_SIM_PIN_CSR 9
+#define VDP_SIM_PIN_CSW 10
+#define VDP_SIM_PIN_MODE 11
+#define VDP_SIM_PIN_RESET 8
+#define VDP_SIM_PIN_INT 2 // Not wired in the schematic. The simulator connects INT to pin 2
+
+/**
+ * @brief Modelled CPU clock and frame rate
+ */
+#define VDP_SIM_F_CPU 16000000UL
+#define VDP_SIM_FRAME_RATE 60
+#define VDP_SIM_FRAME_CYCLES (VDP_SIM_F_CPU / VDP_SIM_FRAME_RATE)
+#define VDP_SIM_VBLANK_CYCLES (VDP_SIM_FRAME_CYCLES * 70 / 262) // 70 of 262 lines
+
+/**
+ * @brief Minimum time between two VRAM accesses of the CPU. Worst case values of the datasheet.
+ */
+#define VDP_SIM_ACCESS_CYCLES (8 * VDP_SIM_CYCLES_PER_US)       // While the screen is drawn
+#define VDP_SIM_ACCESS_CYCLES_BLANK (2 * VDP_SIM_CYCLES_PER_US) // Vertical blank or display off
+
+/**
+ * @brief Estimated cost in CPU cycles of the primitives used by the Core IO functions
+ */
+#define VDP_SIM_CYCLES_DIGITALWRITE 56 // digitalWrite() incl. pin lookup and PWM check
+#define VDP_SIM_CYCLES_PINMODE 60
+#define VDP_SIM_CYCLES_SBI 2        // Set or clear a port bit with sbi/cbi
+#define VDP_SIM_CYCLES_DDR 6        // Read-modify-write of DDRD and DDRC
+#define VDP_SIM_CYCLES_PORTCACHE 6  // Save the port bits that do not belong to the databus
+#define VDP_SIM_CYCLES_WRITEPORT 8  // Merge value into PORTD and PORTC
+#define VDP_SIM_CYCLES_READPORT 5   // Combine PIND and PINC
+#define VDP_SIM_CYCLES_PER_US 16
+
+/**
+ * @brief Bus statistics
+ */
+typedef struct
+{
+    uint64_t cycles;          // Modelled CPU cycles
+    uint32_t vram_writes;     // Bytes written to the data port
+    uint32_t vram_reads;      // Bytes read from the data port
+    uint32_t ctrl_writes;     // Bytes written to the control port
+    uint32_t status_reads;    // Reads of the status register
+    uint32_t address_setups;  // Completed read or write address setups
+    uint32_t register_writes; // Completed register writes
+    uint32_t bus_conflicts;   // Strobes while the data bus had the wrong direction
+    uint32_t access_violations; // VRAM accesses faster than the VDP can handle them
+} VdpSimStats;
+
+/**
+ * @brief Thrown by the simulator when the time limit set by vdp_sim_set_time_limit() is exceeded.
+ * Lets sketches with endless loops run headless.
+ */
+struct VdpSimTimeout
+{
+};
+
+// Called from the Core IO functions and the Arduino stand-in
+void vdp_sim_pin(uint8_t pin, uint8_t level);
+void vdp_sim_bus_dir(bool output);
+void vdp_sim_bus_write(uint8_t value);
+uint8_t vdp_sim_bus_read();
+void vdp_sim_cycles(uint32_t n);
+
+/**
+ * @brief Power on state: VRAM and registers filled with garbage, statistics and clock cleared
+ */
+void vdp_sim_power_on();
+
+/**
+ * @brief Abort with VdpSimTimeout after ms milliseconds of modelled time. 0: No limit
+ */
+void vdp_sim_set_time_limit(uint32_t ms);
+
+VdpSimStats vdp_sim_stats();
+void vdp_sim_reset_stats();
+
+/**
+ * @brief Difference of two statistic snapshots
+ */
+VdpSimStats vdp_sim_diff(const VdpSimStats &after, const VdpSimStats &before);
+
+/**
+ * @brief Modelled time since power on
+ */
+uint64_t vdp_sim_clock();
+
+/**
+ * @brief Call handler at the falling edge of INT, like an interrupt handler. INT goes low at the end of the frame
+ * if the interrupt enable bit of register 1 is set, and high when the status register is read.
+ * The handler must not use the bus. nullptr: detach
+ */
+void vdp_sim_attach_int(void (*handler)());
+
+/**
+ * @brief Level of INT
+ */
+uint8_t vdp_sim_int();
+
+/**
+ * @brief Fault injection for the diagnostics of vdp_diag.h, up to VDP_SIM_FAULTS of each kind.
+ * Stuck bits: The bits in mask of the byte at address always hold the bits of value
+ */
+#define VDP_SIM_FAULTS 8
+void vdp_sim_fault_stuck(uint16_t address, uint8_t mask, uint8_t value);
+
+/**
+ * @brief Coupling fault: A write to aggressor that changes one of the bits in mask inverts these bits at victim
+ */
+void vdp_sim_fault_coupling(uint16_t aggressor, uint16_t victim, uint8_t mask);
+
+/**
+ * @brief Timing faults: VRAM accesses faster than the access window fail, a write is lost and a read returns 0xFF.
+ * The data port also reads 0xFF until data_valid cycles after the falling edge of CSR.
+ * 0: Accesses never fail, violations are only counted in the statistics
+ */
+void vdp_sim_fault_timing(uint8_t data_valid);
+
+/**
+ * @brief Remove all faults
+ */
+void vdp_sim_fault_clear();
+
+// Direct access to the VDP state
+uint8_t *vdp_sim_vram();
+uint8_t vdp_sim_register(uint8_t reg);
+void vdp_sim_set_register(uint8_t reg, uint8_t value); // Without a bus transaction, for tests of the renderer
+uint8_t vdp_sim_status();
+uint16_t vdp_sim_address();
+
+#endif
@@ -15,13 +15,27 @@
     along with this program.  If not, see <https://www.gnu.org/licenses/>.
 */
 
+#include <stdio.h>
+#include <stdarg.h>
 #include "tms9918.h"
+#include "vdp_mode.h"
 #include "patterns.h"
+#include "vdp_pins.h"
+#ifdef VDP_SIM
+#include "vdp_sim.h"
+#endif
+#ifdef ARDUINO_ARCH_AVR
+#include <util/delay_basic.h>
+#endif
+#ifdef RAMTEST
+#include "vdp_diag.h"
+#endif
 
-#define MODE 11
-#define CSW 10
-#define CSR 9
-#define RESET 8
+typedef VdpDefaultPins Pins; // Wiring of the control lines, see vdp_pins.h
+#define MODE Pins::Mode::pin
+#define CSW Pins::Csw::pin
+#define CSR Pins::Csr::pin
+#define RESET Pins::Reset::pin
 #define R1_IE 0x20
 #define R1_M1 0x10
 #define R1_M2 0x08
@@ -47,6 +61,34 @@ uint8_t vdp_mode;
 
 uint8_t fgcolor;
 uint8_t bgcolor;
+bool vram_blank = true; // Display off, the VDP accepts VRAM accesses at full speed
+uint8_t reg1;           // Registers are write only
+
+// Shadow copy of VRAM in RAM. Reads are served locally, writes of unchanged bytes are skipped
+#define VDP_SHADOW_NONE 0
+#define VDP_SHADOW_SPRITES 1 // Sprite attribute table, 128 bytes
+#define VDP_SHADOW_TILES 2   // Sprite attribute table and a cache of VDP_SHADOW_LINES 8 byte lines
+#define VDP_SHADOW_FULL 3    // All 16k
+#ifndef VDP_SHADOW
+#if (defined(RAMEND) && RAMEND < 0x5000) || defined(VDP_SIM) // Less than 20k RAM, e.g. Uno and Nano
+#define VDP_SHADOW VDP_SHADOW_TILES
+#else
+#define VDP_SHADOW VDP_SHADOW_FULL
+#endif
+#endif
+#ifndef VDP_SHADOW_LINES
+#define VDP_SHADOW_LINES 32 // Power of 2
+#endif
+
+// Tile cache of Graphics Mode 2 text: Characters of the same glyph and colors share a pattern, see vdp_tile_cache()
+#ifndef VDP_TILE_CACHE
+#if (defined(RAMEND) && RAMEND < 0x5000) // 8 bytes per entry and third, too much for Uno and Nano
+#define VDP_TILE_CACHE 0
+#else
+#define VDP_TILE_CACHE 64 // Entries per third, multiple of VDP_TILE_WAYS
+#endif
+#endif
+#define VDP_TILE_WAYS 4 // A glyph and its colors can be cached in one of 4 entries
 
 #define FORCE_INLINE //This makes the code faster, but increases memory usage
 #ifdef FORCE_INLINE 
@@ -58,12 +100,78 @@ inline void setDBReadMode() __attribute__((always_inline));
 inline void setDBWriteMode() __attribute__((always_inline));
 #endif
 
+// The VDP needs up to 8us between two VRAM accesses of the CPU while it draws the screen, 2us with the display off.
+// Bursts are padded to these worst case values
+#define VDP_ACCESS_CYCLES (8 * (F_CPU / 1000000))
+#define VDP_ACCESS_CYCLES_BLANK (2 * (F_CPU / 1000000))
+#ifdef VDP_DIRECT_PINS
+#define VDP_BURST_CYCLES 13 // Cycles of the IO functions for one byte of a burst, at least
+#define VDP_SETUP_CYCLES 90 // Cycles to start a write burst, at most
+#else
+#define VDP_BURST_CYCLES 117
+#define VDP_SETUP_CYCLES 470
+#endif
+// vdp_flush() writes with the fast access window for 3/4 of the vertical blank (70 of 262 lines at 60 Hz)
+#define VDP_VBLANK_CYCLES (F_CPU / 60 * 70 / 262)
+#define VDP_BYTE_CYCLES_BLANK (VDP_ACCESS_CYCLES_BLANK > VDP_BURST_CYCLES ? VDP_ACCESS_CYCLES_BLANK : VDP_BURST_CYCLES)
+#define VDP_VBLANK_BYTES (VDP_VBLANK_CYCLES * 3 / 4 / VDP_BYTE_CYCLES_BLANK)
+#define VDP_SETUP_BYTES (VDP_SETUP_CYCLES / VDP_BYTE_CYCLES_BLANK + 1)
+// Time between the falling edge of CSR and valid data, and minimum width of the CSW pulse.
+// digitalWrite() is slow enough without extra delay
+#define VDP_STROBE_CYCLES 4
+
+inline void delayCycles(uint16_t cycles) __attribute__((always_inline));
+void delayCycles(uint16_t cycles)
+{
+#ifdef ARDUINO_ARCH_AVR
+    __builtin_avr_delay_cycles(cycles);
+#elif defined(VDP_SIM)
+    vdp_sim_cycles(cycles);
+#endif
+}
+
+inline void pace() __attribute__((always_inline));
+void pace()
+{
+#if VDP_ACCESS_CYCLES > VDP_BURST_CYCLES
+    if (!vram_blank)
+        delayCycles(VDP_ACCESS_CYCLES - VDP_BURST_CYCLES);
+#endif
+#if VDP_ACCESS_CYCLES_BLANK > VDP_BURST_CYCLES
+    if (vram_blank)
+        delayCycles(VDP_ACCESS_CYCLES_BLANK - VDP_BURST_CYCLES);
+#endif
+}
+
+// The VDP fetches the first byte of a read in its next access window after the address setup
+inline void fetchWait() __attribute__((always_inline));
+void fetchWait()
+{
+    if (vram_blank)
+        delayCycles(VDP_ACCESS_CYCLES_BLANK);
+    else
+        delayCycles(VDP_ACCESS_CYCLES);
+}
+
+inline void strobe() __attribute__((always_inline));
+void strobe()
+{
+#ifdef VDP_DIRECT_PINS
+    delayCycles(VDP_STROBE_CYCLES);
+#endif
+}
+
 //Core IO functions. Make adaptions to other platforms here -->
+uint8_t portd_keep, portc_keep; // Port bits that do not belong to the databus
+
 void setDBReadMode()
 {
 #ifdef ARDUINO_ARCH_AVR
     DDRD = DDRD & B00001111; // Set Pin 4..7 as inputs. High nibble of databus. D7 MSB
     DDRC = DDRC & B11110000; // Set Analog pin 0..3 as inputs A0: LSB
+#elif defined(VDP_SIM)
+    vdp_sim_cycles(VDP_SIM_CYCLES_DDR);
+    vdp_sim_bus_dir(false);
 #endif
 }
 
@@ -71,6 +179,9 @@ uint8_t readPort()
 {
 #ifdef ARDUINO_ARCH_AVR
     return (PIND & 0xF0) | (PINC & 0x0F);
+#elif defined(VDP_SIM)
+    vdp_sim_cycles(VDP_SIM_CYCLES_READPORT);
+    return vdp_sim_bus_read();
 #endif
 }
 
@@ -79,14 +190,22 @@ void setDBWriteMode()
 #ifdef ARDUINO_ARCH_AVR
     DDRD = DDRD | B11110000; // Set Pin 4..7 as outputs. High nibble of databus.
     DDRC = DDRC | B00001111; // Set Analog pin 0..3 as outputs
+    portd_keep = PORTD & 0x0F;
+    portc_keep = PORTC & 0xF0;
+#elif defined(VDP_SIM)
+    vdp_sim_cycles(VDP_SIM_CYCLES_DDR + VDP_SIM_CYCLES_PORTCACHE);
+    vdp_sim_bus_dir(true);
 #endif
 }
 
 void writePort(unsigned char value)
 {
 #ifdef ARDUINO_ARCH_AVR
-    PORTD = (PIND & 0x0F) | (value & 0xF0);
-    PORTC = (PINC & 0xF0) | (value & 0x0F);
+    PORTD = portd_keep | (value & 0xF0);
+    PORTC = portc_keep | (value & 0x0F);
+#elif defined(VDP_SIM)
+    vdp_sim_cycles(VDP_SIM_CYCLES_WRITEPORT);
+    vdp_sim_bus_write(value);
 #endif
 }
 //<-- Core IO functions. Make adaptions to other platforms here
@@ -94,11 +213,12 @@ void writePort(unsigned char value)
 void reset()
 {
     // Serial.println("Resetting");
-    digitalWrite(RESET, HIGH);
+    Pins::Reset::high();
     delayMicroseconds(100);
-    digitalWrite(RESET, LOW);
+    Pins::Reset::low();
+    vram_blank = true;
     delayMicroseconds(5);
-    digitalWrite(RESET, HIGH);
+    Pins::Reset::high();
 }
 
 // Writes a byte to databus for register access
@@ -106,174 +226,988 @@ void writeByte(unsigned char value)
 {
     setDBWriteMode();
     writePort(value);
-    digitalWrite(MODE, HIGH);
-    digitalWrite(CSW, LOW);
-    delayMicroseconds(1);
-    digitalWrite(CSW, HIGH);
+    Pins::Mode::high();
+    Pins::Csw::low();
+    strobe();
+    Pins::Csw::high();
     setDBReadMode();
 }
 
+// Sprite flags and fifth sprite number of the status reads since the last spriteStatus().
+// Reading the register clears them, e.g. when the frame flag is polled
+uint8_t sprite_flags;
+
 // Reads a byte from databus for register access
 uint8_t read_status_reg()
 {
+    VDP_COUNT(status_reads);
     setDBReadMode();
-    digitalWrite(MODE, HIGH);
-    digitalWrite(CSR, LOW);
-    delayMicroseconds(1);
+    Pins::Mode::high();
+    Pins::Csr::low();
+    strobe();
     uint8_t memByte = readPort();
-    digitalWrite(CSR, HIGH);
+    Pins::Csr::high();
+    if (!(sprite_flags & VDP_FLAG_S5)) // Keep the number of the first fifth sprite
+        sprite_flags = (sprite_flags & VDP_FLAG_COIN) | (memByte & ~VDP_FLAG_FRAME);
+    sprite_flags |= memByte & VDP_FLAG_COIN;
     return memByte;
 }
 
+// Status register with the sprite flags of all reads since the last call
+uint8_t spriteStatus()
+{
+    uint8_t status = (read_status_reg() & VDP_FLAG_FRAME) | sprite_flags;
+    sprite_flags = 0;
+    return status;
+}
+
 // Writes a byte to databus for vram access
 void writeByteToVRAM(unsigned char value)
 {
-    digitalWrite(MODE, LOW);
-    digitalWrite(CSW, LOW);
+    VDP_COUNT(bytes_written);
+    Pins::Mode::low();
+    Pins::Csw::low();
     setDBWriteMode();
     writePort(value);
-    //delayMicroseconds(1);
-    digitalWrite(CSW, HIGH);
+    strobe();
+    Pins::Csw::high();
     setDBReadMode();
-    //delayMicroseconds(10);
+    pace();
 }
 
 // Reads a byte from databus for vram access
 unsigned char readByteFromVRAM()
 {
+    VDP_COUNT(bytes_read);
     unsigned char memByte = 0;
-    digitalWrite(MODE, LOW);
-    digitalWrite(CSR, LOW);
-    //delayMicroseconds(1);
+    Pins::Mode::low();
+    Pins::Csr::low();
+    strobe();
     memByte = readPort();
-    digitalWrite(CSR, HIGH);
-    //delayMicroseconds(10);
+    Pins::Csr::high();
+    pace();
     return memByte;
 }
 
 void setRegister(unsigned char registerIndex, unsigned char value)
 {
+    VDP_COUNT(register_writes);
     writeByte(value);
     writeByte(0x80 | registerIndex);
+    if (registerIndex == 1)
+    {
+        reg1 = value;
+        vram_blank = !(value & 0x40);
+    }
 }
 
 void setWriteAddress(unsigned int address)
 {
+    VDP_COUNT(address_setups);
     writeByte(address & 0xff);
     writeByte(0x40 | (address >> 8) & 0x3f);
 }
 
 void setReadAddress(unsigned int address)
 {
+    VDP_COUNT(address_setups);
     writeByte(address & 0xff);
     writeByte((address >> 8) & 0x3f);
 }
 
-int vdp_init(uint8_t mode, uint8_t color, bool big_sprites, bool magnify)
+bool double_buffer; // Drawing functions write to the shadow only, vdp_flush() transfers the changes
+#if VDP_SHADOW == VDP_SHADOW_FULL
+uint8_t shadow[0x4000];
+uint8_t dirty[0x4000 / 64]; // One bit per changed 8 byte cell
+#elif VDP_SHADOW >= VDP_SHADOW_SPRITES
+uint8_t sat_shadow[128];
+bool sat_valid;
+uint16_t sat_dirty; // One bit per changed 8 byte cell
+#endif
+#if VDP_SHADOW == VDP_SHADOW_TILES
+uint8_t line_data[VDP_SHADOW_LINES][8];
+uint16_t line_tag[VDP_SHADOW_LINES]; // (Address >> 3) of the cached line, 0xFFFF: empty
+uint8_t line_dirty[VDP_SHADOW_LINES / 8]; // One bit per changed line
+
+// Lines at 0x2000 and above go to the other half of the cache, so pattern and color of a cell do not evict each other
+inline uint8_t lineIndex(uint16_t address) __attribute__((always_inline));
+uint8_t lineIndex(uint16_t address)
 {
-    vdp_mode = mode;
-    sprite_size_sel = big_sprites;
-    pinMode(MODE, OUTPUT);
-    pinMode(RESET, OUTPUT);
-    pinMode(CSW, OUTPUT);
-    pinMode(CSR, OUTPUT);
+    return ((address >> 3) + (address >> 13) * (VDP_SHADOW_LINES / 2)) & (VDP_SHADOW_LINES - 1);
+}
+#endif
 
-    digitalWrite(RESET, HIGH);
-    digitalWrite(MODE, HIGH);
-    digitalWrite(CSW, HIGH);
-    digitalWrite(CSR, HIGH);
-    reset();
-#ifdef RAMTEST
-    // Test RAM
-    setWriteAddress(0x0);
-    for (int i = 0; i < 0x3fff; i++)
+// Forget the shadowed content, e.g. after a reset
+void shadowInvalidate()
+{
+#if VDP_SHADOW == VDP_SHADOW_FULL
+    memset(dirty, 0, sizeof(dirty));
+#elif VDP_SHADOW >= VDP_SHADOW_SPRITES
+    sat_valid = false;
+    sat_dirty = 0;
+#endif
+#if VDP_SHADOW == VDP_SHADOW_TILES
+    memset(line_tag, 0xFF, sizeof(line_tag));
+    memset(line_dirty, 0, sizeof(line_dirty));
+#endif
+}
+
+// Keep the shadow coherent with a byte written to VRAM
+inline void shadowStore(uint16_t address, uint8_t value) __attribute__((always_inline));
+void shadowStore(uint16_t address, uint8_t value)
+{
+#if VDP_SHADOW == VDP_SHADOW_FULL
+    shadow[address & 0x3FFF] = value;
+#elif VDP_SHADOW >= VDP_SHADOW_SPRITES
+    if ((uint16_t)(address - sprite_attribute_table) < 128)
+        sat_shadow[address - sprite_attribute_table] = value;
+#endif
+#if VDP_SHADOW == VDP_SHADOW_TILES
+    uint8_t line = lineIndex(address);
+    if (line_tag[line] == address >> 3)
+        line_data[line][address & 7] = value;
+#endif
+}
+
+// Burst access: The address is set once and the VDP increments it with every byte.
+// The databus stays in write mode until the burst ends
+uint16_t burst_address; // Next address of a write burst, to keep the shadow coherent
+
+void beginWriteBurst(uint16_t address)
+{
+    burst_address = address;
+    setWriteAddress(address);
+    Pins::Mode::low();
+    setDBWriteMode();
+}
+
+inline void writeBurstByte(uint8_t value) __attribute__((always_inline));
+void writeBurstByte(uint8_t value)
+{
+    VDP_COUNT(bytes_written);
+#if VDP_SHADOW != VDP_SHADOW_NONE
+    shadowStore(burst_address++, value);
+#endif
+    writePort(value);
+    Pins::Csw::low();
+    strobe();
+    Pins::Csw::high();
+    pace();
+}
+
+void endWriteBurst()
+{
+    setDBReadMode();
+}
+
+void beginReadBurst(uint16_t address)
+{
+    setReadAddress(address);
+    Pins::Mode::low();
+    fetchWait();
+}
+
+inline uint8_t readBurstByte() __attribute__((always_inline));
+uint8_t readBurstByte()
+{
+    VDP_COUNT(bytes_read);
+    Pins::Csr::low();
+    strobe();
+    uint8_t value = readPort();
+    Pins::Csr::high();
+    pace();
+    return value;
+}
+
+// Delay of 3 cycles per count, for timing chosen at run time
+void delayLoop(uint8_t count)
+{
+#ifdef ARDUINO_ARCH_AVR
+    if (count)
+        _delay_loop_1(count);
+#elif defined(VDP_SIM)
+    vdp_sim_cycles(3 * count);
+#endif
+}
+
+// VRAM accesses with the timing of vdp_diag: CSW or CSR stay low for strobe delay loops, and each access is followed by
+// gap delay loops. The shadow is left out, the diagnostics overwrite VRAM
+void diagWrite(uint16_t address, const uint8_t *src, uint16_t len, uint8_t strobe, uint8_t gap)
+{
+    setWriteAddress(address);
+    Pins::Mode::low();
+    setDBWriteMode();
+    while (len--)
+    {
+        VDP_COUNT(bytes_written);
+        writePort(*src++);
+        Pins::Csw::low();
+        delayLoop(strobe);
+        Pins::Csw::high();
+        delayLoop(gap);
+    }
+    setDBReadMode();
+}
+
+void diagRead(uint16_t address, uint8_t *dst, uint16_t len, uint8_t strobe, uint8_t gap)
+{
+    setReadAddress(address);
+    Pins::Mode::low();
+    delayLoop(gap); // The VDP fetches the first byte
+    while (len--)
+    {
+        VDP_COUNT(bytes_read);
+        Pins::Csr::low();
+        delayLoop(strobe);
+        *dst++ = readPort();
+        Pins::Csr::high();
+        delayLoop(gap);
+    }
+}
+
+#if VDP_SHADOW == VDP_SHADOW_TILES
+bool lineDirty(uint8_t line)
+{
+    return line_dirty[line >> 3] & (1 << (line & 7));
+}
+
+// Write a changed line back to VRAM
+void lineWriteBack(uint8_t line)
+{
+    line_dirty[line >> 3] &= ~(1 << (line & 7));
+    beginWriteBurst(line_tag[line] << 3);
+    for (uint8_t i = 0; i < 8; i++)
+        writeBurstByte(line_data[line][i]);
+    endWriteBurst();
+}
+
+// Bring the line of address into the cache. fill: Load its content from VRAM
+uint8_t lineLoad(uint16_t address, bool fill)
+{
+    uint8_t line = lineIndex(address);
+    if (line_tag[line] != address >> 3)
+    {
+        if (lineDirty(line))
+            lineWriteBack(line);
+        line_tag[line] = address >> 3;
+        if (fill)
+        {
+            beginReadBurst(address & ~7);
+            for (uint8_t i = 0; i < 8; i++)
+                line_data[line][i] = readBurstByte();
+        }
+    }
+    return line;
+}
+#endif
+
+uint16_t vdp_pattern_table()
+{
+    return pattern_table;
+}
+
+uint16_t vdp_color_table()
+{
+    return color_table;
+}
+
+uint16_t vdp_name_table()
+{
+    return name_table;
+}
+
+uint8_t vdp_screen_mode()
+{
+    return vdp_mode;
+}
+
+const uint8_t *vdp_font()
+{
+    return ASCII;
+}
+
+void vdp_write_block(uint16_t addr, const uint8_t *src, uint16_t len)
+{
+    VDP_API(vdp_write_block);
+    beginWriteBurst(addr);
+    while (len--)
+        writeBurstByte(*src++);
+    endWriteBurst();
+}
+
+void vdp_write_block_P(uint16_t addr, const uint8_t *src, uint16_t len)
+{
+    VDP_API(vdp_write_block_P);
+    beginWriteBurst(addr);
+    while (len--)
+        writeBurstByte(pgm_read_byte(src++));
+    endWriteBurst();
+}
+
+void vdp_fill(uint16_t addr, uint8_t value, uint16_t len)
+{
+    VDP_API(vdp_fill);
+    beginWriteBurst(addr);
+    while (len--)
+        writeBurstByte(value);
+    endWriteBurst();
+}
+
+void vdp_read_block(uint16_t addr, uint8_t *dst, uint16_t len)
+{
+    VDP_API(vdp_read_block);
+#if VDP_SHADOW == VDP_SHADOW_FULL
+    while (len--)
+        *dst++ = shadow[addr++ & 0x3FFF];
+#else
+    beginReadBurst(addr);
+    for (uint16_t i = 0; i < len; i++)
+        dst[i] = readBurstByte();
+#if VDP_SHADOW != VDP_SHADOW_NONE
+    if (double_buffer) // VRAM lags behind the shadow until the next vdp_flush()
+    {
+        for (uint16_t i = 0; i < len; i++)
+        {
+            uint16_t address = addr + i;
+            if ((uint16_t)(address - sprite_attribute_table) < 128 && sat_valid)
+                dst[i] = sat_shadow[address - sprite_attribute_table];
+#if VDP_SHADOW == VDP_SHADOW_TILES
+            else if (line_tag[lineIndex(address)] == address >> 3)
+                dst[i] = line_data[lineIndex(address)][address & 7];
+#endif
+        }
+    }
+#endif
+#endif
+}
+
+// Read a byte of VRAM, from the shadow if possible
+uint8_t peekVRAM(uint16_t address)
+{
+#if VDP_SHADOW == VDP_SHADOW_FULL
+    return shadow[address & 0x3FFF];
+#else
+#if VDP_SHADOW >= VDP_SHADOW_SPRITES
+    uint16_t sat_offset = address - sprite_attribute_table;
+    if (sat_offset < 128)
+    {
+        if (!sat_valid)
+        {
+            beginReadBurst(sprite_attribute_table);
+            for (uint8_t i = 0; i < 128; i++)
+                sat_shadow[i] = readBurstByte();
+            sat_valid = true;
+        }
+        return sat_shadow[sat_offset];
+    }
+#endif
+#if VDP_SHADOW == VDP_SHADOW_TILES
+    return line_data[lineLoad(address, true)][address & 7];
+#else
+    setReadAddress(address);
+    fetchWait();
+    return readByteFromVRAM();
+#endif
+#endif
+}
+
+#if VDP_SHADOW != VDP_SHADOW_NONE
+// Store len <= 8 bytes that do not cross an 8 byte boundary in the shadow and mark them for vdp_flush()
+void deferCell(uint16_t address, const uint8_t *src, uint8_t len)
+{
+#if VDP_SHADOW == VDP_SHADOW_FULL
+    memcpy(shadow + (address & 0x3FFF), src, len);
+    dirty[(address & 0x3FFF) >> 6] |= 1 << ((address >> 3) & 7);
+#else
+    uint16_t sat_offset = address - sprite_attribute_table;
+    if (sat_offset < 128)
+    {
+        peekVRAM(sprite_attribute_table); // Load the table
+        memcpy(sat_shadow + sat_offset, src, len);
+        sat_dirty |= 1 << (sat_offset >> 3);
+        return;
+    }
+#if VDP_SHADOW == VDP_SHADOW_TILES
+    uint8_t line = lineLoad(address, len < 8);
+    memcpy(line_data[line] + (address & 7), src, len);
+    line_dirty[line >> 3] |= 1 << (line & 7);
+#else
+    vdp_write_block(address, src, len); // Only the sprite attribute table is buffered
+#endif
+#endif
+}
+#endif
+
+// Write a block of VRAM, or of the shadow while double buffering
+void storeVRAM(uint16_t address, const uint8_t *src, uint8_t len)
+{
+#if VDP_SHADOW != VDP_SHADOW_NONE
+    if (double_buffer)
+    {
+        while (len)
+        {
+            uint8_t n = 8 - (address & 7);
+            if (n > len)
+                n = len;
+            deferCell(address, src, n);
+            address += n;
+            src += n;
+            len -= n;
+        }
+        return;
+    }
+#endif
+    vdp_write_block(address, src, len);
+}
+
+// Write a block of VRAM. Only the bytes from the first to the last changed one are transferred
+void pokeVRAM(uint16_t address, const uint8_t *src, uint8_t len)
+{
+    uint8_t first = 0, last = len;
+    while (first < len && peekVRAM(address + first) == src[first])
+        first++;
+    if (first == len)
+        return;
+    while (peekVRAM(address + last - 1) == src[last - 1])
+        last--;
+    storeVRAM(address + first, src + first, last - first);
+}
+
+void pokeVRAM(uint16_t address, uint8_t value)
+{
+    pokeVRAM(address, &value, 1);
+}
+
+#ifndef VDP_QUEUE_SIZE
+#define VDP_QUEUE_SIZE 8
+#endif
+
+struct
+{
+    VdpJob job;
+    void *arg;
+    uint16_t bytes;
+} queue[VDP_QUEUE_SIZE];
+uint8_t queue_head, queue_tail;
+
+bool vblank_service;
+uint16_t frame_budget = VDP_VBLANK_BYTES; // Maximum VRAM bytes of the jobs run per frame
+uint16_t frame_bytes; // VRAM bytes of the jobs run in the current frame
+uint16_t frame_count;
+int16_t vblank_bytes; // Bytes that still fit into the fast access window of the current vertical blank
+
+#ifdef VDP_INT_PIN
+volatile bool frame_irq;             // Set at the falling edge of INT
+volatile unsigned long frame_micros; // Time of the falling edge
+
+void frameISR()
+{
+    frame_irq = true;
+    frame_micros = micros();
+}
+#endif
+
+// Check for the end of a frame. Sets vblank_bytes
+bool frameTick()
+{
+#ifdef VDP_INT_PIN
+    if (vblank_service)
+    {
+        noInterrupts();
+        bool tick = frame_irq;
+        unsigned long since = micros() - frame_micros;
+        frame_irq = false;
+        interrupts();
+        if (!tick)
+            return false;
+        read_status_reg(); // Release INT
+        frame_count++;
+        const unsigned long window = VDP_VBLANK_CYCLES * 3 / 4 / (F_CPU / 1000000); // us
+        vblank_bytes = since < window ? (window - since) * (F_CPU / 1000000) / VDP_BYTE_CYCLES_BLANK : 0;
+        return true;
+    }
+#endif
+    if (!(read_status_reg() & VDP_FLAG_FRAME))
+        return false;
+    frame_count++;
+    vblank_bytes = 0; // The flag may have been set long ago
+    return true;
+}
+
+// Wait for the start of the vertical blank
+void waitVBlank()
+{
+    if (frameTick() && vblank_bytes > 0) // Fresh tick from the interrupt handler
+        return;
+    while (!frameTick())
+        ;
+#ifdef VDP_INT_PIN
+    if (vblank_service)
+        return;
+#endif
+    vblank_bytes = VDP_VBLANK_BYTES; // Polled right at the tick
+}
+
+// The interrupt enable bit is set while the frame tick is used
+void updateIE()
+{
+    uint8_t value = double_buffer || vblank_service ? reg1 | R1_IE : reg1 & ~R1_IE;
+    if (value != reg1)
+        setRegister(1, value);
+}
+
+int16_t flush_budget; // Bytes that can still be written in the vertical blank
+bool flush_blank;     // Access window after the vertical blank
+
+void flushBurst(uint16_t address)
+{
+    flush_budget -= VDP_SETUP_BYTES;
+    beginWriteBurst(address);
+}
+
+void flushBytes(const uint8_t *src, uint8_t len)
+{
+    while (len--)
+    {
+        if (flush_budget > 0)
+            flush_budget--;
+        else
+            vram_blank = flush_blank;
+        writeBurstByte(*src++);
+    }
+}
+
+void vdp_flush(bool wait_vblank)
+{
+    VDP_API(vdp_flush);
+    flush_blank = vram_blank;
+    flush_budget = 0;
+    if (wait_vblank)
+    {
+        waitVBlank();
+        vram_blank = true;
+        flush_budget = vblank_bytes;
+    }
+#if VDP_SHADOW == VDP_SHADOW_FULL
+    // Runs of adjacent dirty cells are written in a single burst
+    for (uint16_t cell = 0; cell < 0x4000 / 8;)
+    {
+        if (!dirty[cell >> 3])
+        {
+            cell = (cell | 7) + 1;
+            continue;
+        }
+        if (!(dirty[cell >> 3] & (1 << (cell & 7))))
+        {
+            cell++;
+            continue;
+        }
+        flushBurst(cell << 3);
+        while (cell < 0x4000 / 8 && (dirty[cell >> 3] & (1 << (cell & 7))))
+        {
+            dirty[cell >> 3] &= ~(1 << (cell & 7));
+            flushBytes(shadow + (cell << 3), 8);
+            cell++;
+        }
+        endWriteBurst();
+    }
+#elif VDP_SHADOW >= VDP_SHADOW_SPRITES
+    for (uint8_t cell = 0; sat_dirty; cell++)
+    {
+        if (!(sat_dirty & (1 << cell)))
+            continue;
+        flushBurst(sprite_attribute_table + (cell << 3));
+        while (sat_dirty & (1 << cell))
+        {
+            sat_dirty &= ~(1 << cell);
+            flushBytes(sat_shadow + (cell << 3), 8);
+            cell++;
+        }
+        endWriteBurst();
+    }
+#endif
+#if VDP_SHADOW == VDP_SHADOW_TILES
+    // Sort the dirty lines by address and write lines with consecutive addresses in a single burst
+    uint8_t order[VDP_SHADOW_LINES];
+    uint8_t n = 0;
+    for (uint8_t line = 0; line < VDP_SHADOW_LINES; line++)
+    {
+        if (!lineDirty(line))
+            continue;
+        uint8_t i = n++;
+        for (; i > 0 && line_tag[order[i - 1]] > line_tag[line]; i--)
+            order[i] = order[i - 1];
+        order[i] = line;
+    }
+    memset(line_dirty, 0, sizeof(line_dirty));
+    for (uint8_t i = 0; i < n; i++)
+    {
+        if (i == 0 || line_tag[order[i]] != line_tag[order[i - 1]] + 1)
+        {
+            if (i > 0)
+                endWriteBurst();
+            flushBurst(line_tag[order[i]] << 3);
+        }
+        flushBytes(line_data[order[i]], 8);
+    }
+    if (n > 0)
+        endWriteBurst();
+#endif
+    vram_blank = flush_blank;
+}
+
+int vdp_double_buffer(bool enable)
+{
+    VDP_API(vdp_double_buffer);
+#if VDP_SHADOW == VDP_SHADOW_NONE
+    return enable ? VDP_ERROR : VDP_OK;
+#else
+    if (!enable)
+        vdp_flush(false);
+    double_buffer = enable;
+    updateIE();
+    return VDP_OK;
+#endif
+}
+
+void vdp_vblank_service(bool enable, uint16_t budget)
+{
+    VDP_API(vdp_vblank_service);
+    frame_budget = budget ? budget : VDP_VBLANK_BYTES;
+    if (enable == vblank_service)
+        return;
+#ifdef VDP_INT_PIN
+    if (enable)
+    {
+        frame_irq = false;
+        pinMode(VDP_INT_PIN, INPUT_PULLUP);
+        attachInterrupt(digitalPinToInterrupt(VDP_INT_PIN), frameISR, FALLING);
+    }
+    else
+        detachInterrupt(digitalPinToInterrupt(VDP_INT_PIN));
+#endif
+    vblank_service = enable;
+    read_status_reg(); // Clear the frame flag, INT goes low at the end of the next frame
+    updateIE();
+}
+
+bool vdp_queue(VdpJob job, void *arg, uint16_t bytes)
+{
+    uint8_t next = (queue_tail + 1) % VDP_QUEUE_SIZE;
+    if (next == queue_head)
+        return false;
+    queue[queue_tail].job = job;
+    queue[queue_tail].arg = arg;
+    queue[queue_tail].bytes = bytes;
+    queue_tail = next;
+    return true;
+}
+
+int vdp_service(bool wait)
+{
+    VDP_API(vdp_service);
+    if (wait)
+        waitVBlank();
+    else if (!frameTick())
+        return -1;
+    frame_bytes = 0;
+    int16_t window = vblank_bytes;
+    bool blank = vram_blank;
+    vram_blank = true;
+    int n = 0;
+    while (queue_head != queue_tail)
+    {
+        VdpJob job = queue[queue_head].job;
+        void *arg = queue[queue_head].arg;
+        uint16_t bytes = queue[queue_head].bytes;
+        if (n > 0 && frame_bytes + bytes > frame_budget) // A job larger than the budget runs alone
+            break;
+        queue_head = (queue_head + 1) % VDP_QUEUE_SIZE;
+        window -= bytes + VDP_SETUP_BYTES;
+        if (window < 0) // Past the vertical blank
+            vram_blank = blank;
+        job(arg);
+        frame_bytes += bytes;
+        n++;
+    }
+    vram_blank = blank;
+    return n;
+}
+
+uint16_t vdp_frame_count()
+{
+    return frame_count;
+}
+
+uint16_t vdp_frame_bytes()
+{
+    return frame_bytes;
+}
+
+#if VDP_TILE_CACHE
+bool tile_cache;
+struct TileEntry
+{
+    uint16_t key;   // Glyph << 8 | color, 0: empty
+    uint16_t stamp; // Time of the last use, for LRU eviction
+    uint16_t refs; // Cells showing the pattern
+    uint8_t pattern;
+} tile_entries[3][VDP_TILE_CACHE];
+uint8_t tile_used[3][32];   // One bit per pattern that is in use by an entry or a single cell
+uint8_t tile_cached[3][32]; // One bit per pattern that belongs to an entry
+uint16_t tile_clock;
+
+inline bool testBit(const uint8_t *bits, uint8_t n) { return bits[n >> 3] & (1 << (n & 7)); }
+inline void setBit(uint8_t *bits, uint8_t n, bool value)
+{
+    if (value)
+        bits[n >> 3] |= 1 << (n & 7);
+    else
+        bits[n >> 3] &= ~(1 << (n & 7));
+}
+
+TileEntry *tileEntry(uint8_t third, uint8_t pattern)
+{
+    for (uint8_t i = 0; i < VDP_TILE_CACHE; i++)
+        if (tile_entries[third][i].key && tile_entries[third][i].pattern == pattern)
+            return &tile_entries[third][i];
+    return NULL;
+}
+
+// The cell no longer shows pattern
+void tileRelease(uint8_t third, uint8_t pattern)
+{
+    if (testBit(tile_cached[third], pattern))
+        tileEntry(third, pattern)->refs--; // Stays cached until evicted
+    else
+        setBit(tile_used[third], pattern, false);
+}
+
+// A pattern that no cell shows. Patterns of cached glyphs are only taken if no other is free
+uint8_t tileAlloc(uint8_t third)
+{
+    for (uint8_t i = 0; i < 32; i++)
+        if (tile_used[third][i] != 0xFF)
+            for (uint8_t b = 0; b < 8; b++)
+                if (!(tile_used[third][i] & (1 << b)))
+                {
+                    setBit(tile_used[third], i * 8 + b, true);
+                    return i * 8 + b;
+                }
+    // As many cells as patterns, and the cell to be written has released its pattern: One entry is unused
+    TileEntry *lru = NULL;
+    for (uint8_t i = 0; i < VDP_TILE_CACHE; i++)
+    {
+        TileEntry *e = &tile_entries[third][i];
+        if (e->key && !e->refs && (!lru || (uint16_t)(tile_clock - e->stamp) > (uint16_t)(tile_clock - lru->stamp)))
+            lru = e;
+    }
+    lru->key = 0;
+    setBit(tile_cached[third], lru->pattern, false);
+    return lru->pattern;
+}
+
+// Show chr in color at the cell of the name table. Writes only the name if the glyph is cached
+void tileWrite(uint16_t cell, uint8_t chr, uint8_t color)
+{
+    uint8_t third = cell >> 8;
+    uint16_t key = chr << 8 | color;
+    TileEntry *set = tile_entries[third] + (uint8_t)(chr * 7 + color) % (VDP_TILE_CACHE / VDP_TILE_WAYS) * VDP_TILE_WAYS;
+    TileEntry *entry = NULL;
+    tile_clock++;
+    for (uint8_t i = 0; i < VDP_TILE_WAYS; i++)
+        if (set[i].key == key)
+            entry = set + i;
+    uint8_t old = peekVRAM(name_table + cell);
+    if (entry && entry->pattern == old)
     {
-        writeByteToVRAM(i);
+        entry->stamp = tile_clock;
+        return; // Already on the screen
     }
-    setReadAddress(0x00);
-    for (int i = 0; i < 0x3fff; i++)
+    tileRelease(third, old);
+    uint8_t pattern;
+    if (entry)
     {
-        if (readByteFromVRAM() != (uint8_t)i)
-            return VDP_ERROR;
+        entry->refs++;
+        entry->stamp = tile_clock;
+        pattern = entry->pattern;
     }
+    else
+    {
+        // An empty entry of the set, else the least recently used one that is not on the screen
+        TileEntry *victim = NULL;
+        for (uint8_t i = 0; i < VDP_TILE_WAYS; i++)
+        {
+            TileEntry *e = set + i;
+            if (!e->key)
+            {
+                victim = e;
+                break;
+            }
+            if (!e->refs && (!victim || (uint16_t)(tile_clock - e->stamp) > (uint16_t)(tile_clock - victim->stamp)))
+                victim = e;
+        }
+        if (victim && victim->key)
+            pattern = victim->pattern; // Evicted, the pattern is overwritten
+        else
+            pattern = tileAlloc(third);
+        if (victim)
+        {
+            victim->key = key;
+            victim->stamp = tile_clock;
+            victim->pattern = pattern;
+            victim->refs = 1;
+            setBit(tile_cached[third], pattern, true);
+        }
+        // else: All entries of the set are on the screen, the cell gets a pattern of its own
+        uint8_t glyph[8];
+        memcpy_P(glyph, ASCII + ((chr - 32) << 3), 8);
+        uint16_t offset = (third << 11) + (pattern << 3);
+        storeVRAM(pattern_table + offset, glyph, 8);
+        memset(glyph, color, 8);
+        storeVRAM(color_table + offset, glyph, 8);
+    }
+    storeVRAM(name_table + cell, &pattern, 1);
+}
 #endif
-    // Clear Ram
-    setWriteAddress(0x0);
-    for (int i = 0; i < 0x3FFF; i++)
-        writeByteToVRAM(0);
+
+int vdp_tile_cache(bool enable)
+{
+    VDP_API(vdp_tile_cache);
+#if VDP_TILE_CACHE
+    if (vdp_mode != VDP_MODE_G2)
+        return VDP_ERROR;
+    if (enable == tile_cache)
+        return VDP_OK;
+    // Every cell shows a pattern of its own, as set up by vdp_init()
+    memset(tile_entries, 0, sizeof(tile_entries));
+    memset(tile_used, 0xFF, sizeof(tile_used));
+    memset(tile_cached, 0, sizeof(tile_cached));
+    if (!enable)
+    {
+        vdp_fill(pattern_table, 0, 0x1800);
+        beginWriteBurst(name_table);
+        for (uint16_t i = 0; i < 768; i++)
+            writeBurstByte(i);
+        endWriteBurst();
+    }
+    tile_cache = enable;
+    return VDP_OK;
+#else
+    return enable ? VDP_ERROR : VDP_OK;
+#endif
+}
+
+// Table addresses and row width of SCREEN_MODE, for the functions that check the mode at run time
+template <uint8_t SCREEN_MODE>
+void useTables()
+{
+    pattern_table = Vdp<SCREEN_MODE>::pattern_table;
+    name_table = Vdp<SCREEN_MODE>::name_table;
+    color_table = Vdp<SCREEN_MODE>::color_table;
+    color_table_size = Vdp<SCREEN_MODE>::color_table_size;
+    sprite_attribute_table = Vdp<SCREEN_MODE>::sprite_attribute_table;
+    sprite_pattern_table = Vdp<SCREEN_MODE>::sprite_pattern_table;
+    crsr_max_x = Vdp<SCREEN_MODE>::columns - 1;
+}
+
+// Clear the tables of SCREEN_MODE, except for what setMode() writes anyway: The font and the name tables of G2 and Multicolor
+template <uint8_t SCREEN_MODE>
+void clearTables()
+{
+    typedef Vdp<SCREEN_MODE> Mode;
+    if (Mode::has_sprites)
+    {
+        vdp_fill(Mode::sprite_pattern_table, 0, 0x800);
+        vdp_fill(Mode::sprite_attribute_table, 0, 128);
+    }
+    if (SCREEN_MODE == VDP_MODE_G1 || SCREEN_MODE == VDP_MODE_TEXT)
+    {
+        vdp_fill(Mode::pattern_table, 0, 0x100); // Around the font in 0x100 - 0x3FF
+        vdp_fill(Mode::pattern_table + 0x400, 0, Mode::pattern_table_size - 0x400);
+        vdp_fill(Mode::name_table, 0, Mode::columns * Mode::rows);
+    }
+    else
+        vdp_fill(Mode::pattern_table, 0, Mode::pattern_table_size);
+    if (Mode::color_table_size)
+        vdp_fill(Mode::color_table, 0, Mode::color_table_size);
+}
+
+// Registers and tables of a mode. The display is off while the tables are written, so VRAM is accessed at full speed
+int setMode(uint8_t mode, uint8_t color, bool big_sprites, bool magnify, bool clear)
+{
+    uint8_t r1;
+    vdp_mode = mode;
+    sprite_size_sel = big_sprites;
+    double_buffer = false;
+#if VDP_TILE_CACHE
+    tile_cache = false;
+#endif
+    shadowInvalidate();
+    setRegister(1, 0x80); // Ram size 16k, display off
 
     switch (mode)
     {
     case VDP_MODE_G1:
+        useTables<VDP_MODE_G1>();
+        if (clear)
+            clearTables<VDP_MODE_G1>();
         setRegister(0, 0x00);
-        setRegister(1, 0xC0 | (big_sprites << 1) | magnify); // Ram size 16k, activate video output
+        r1 = 0xC0 | (big_sprites << 1) | magnify; // Ram size 16k, activate video output
         setRegister(2, 0x05); // Name table at 0x1400
         setRegister(3, 0x80); // Color, start at 0x2000
         setRegister(4, 0x01); // Pattern generator start at 0x800
         setRegister(5, 0x20); // Sprite attriutes start at 0x1000
         setRegister(6, 0x00); // Sprite pattern table at 0x000
-        sprite_pattern_table = 0;
-        pattern_table = 0x800;
-        sprite_attribute_table = 0x1000;
-        name_table = 0x1400;
-        color_table = 0x2000;
-        color_table_size = 32;
         // Initialize pattern table with ASCII patterns
-        setWriteAddress(pattern_table + 0x100);
-        for (uint16_t i = 0; i < 768; i++)
-            // writeByteToVRAM(patterns[i]);
-            writeByteToVRAM(pgm_read_byte(ASCII + i));
+        vdp_write_block_P(pattern_table + 0x100, ASCII, 768);
         break;
 
     case VDP_MODE_G2:
+        useTables<VDP_MODE_G2>();
+        if (clear)
+            clearTables<VDP_MODE_G2>();
         setRegister(0, 0x02);
-        setRegister(1, 0xC0 | (big_sprites << 1) | magnify); // Ram size 16k, Disable Int, 16x16 Sprites, mag off, activate video output
+        r1 = 0xC0 | (big_sprites << 1) | magnify; // Ram size 16k, Disable Int, 16x16 Sprites, mag off, activate video output
         setRegister(2, 0x0E); // Name table at 0x3800
         setRegister(3, 0xFF); // Color, start at 0x2000
         setRegister(4, 0x03); // Pattern generator start at 0x0
         setRegister(5, 0x76); // Sprite attriutes start at 0x3800
         setRegister(6, 0x03); // Sprite pattern table at 0x1800
-        pattern_table = 0x00;
-        sprite_pattern_table = 0x1800;
-        color_table = 0x2000;
-        name_table = 0x3800;
-        sprite_attribute_table = 0x3B00;
-        color_table_size = 0x1800;
-        setWriteAddress(name_table);
+        beginWriteBurst(name_table);
         for (uint16_t i = 0; i < 768; i++)
-            writeByteToVRAM(i);
+            writeBurstByte(i);
+        endWriteBurst();
         break;
 
     case VDP_MODE_TEXT:
+        useTables<VDP_MODE_TEXT>();
+        if (clear)
+            clearTables<VDP_MODE_TEXT>();
         setRegister(0, 0x00);
-        setRegister(1, 0xD2); // Ram size 16k, Disable Int
+        r1 = 0xD2; // Ram size 16k, Disable Int
         setRegister(2, 0x02); // Name table at 0x800
         setRegister(4, 0x00); // Pattern table start at 0x0
-        pattern_table = 0x00;
-        name_table = 0x800;
-        crsr_max_x = 39;
-        setWriteAddress(pattern_table + 0x100);
-        for (uint16_t i = 0; i < 768; i++)
-            // writeByteToVRAM(patterns[i]);
-            writeByteToVRAM(pgm_read_byte(ASCII + i));
+        vdp_write_block_P(pattern_table + 0x100, ASCII, 768);
         vdp_textcolor(VDP_WHITE, VDP_BLACK);
         break;
 
     case VDP_MODE_MULTICOLOR:
+        useTables<VDP_MODE_MULTICOLOR>();
+        if (clear)
+            clearTables<VDP_MODE_MULTICOLOR>();
         setRegister(0, 0x00);
-        setRegister(1, 0xC8 | (big_sprites << 1) | magnify); // Ram size 16k, Multicolor
+        r1 = 0xC8 | (big_sprites << 1) | magnify; // Ram size 16k, Multicolor
         setRegister(2, 0x05); // Name table at 0x1400
         // setRegister(3, 0xFF); // Color table not available
         setRegister(4, 0x01); // Pattern table start at 0x800
-        setRegister(5, 0x76); // Sprite Attribute table at 0x1000
-        setRegister(6, 0x03); // Sprites Pattern Table at 0x0
-        pattern_table = 0x800;
-        name_table = 0x1400;
-        setWriteAddress(name_table); // Init name table
+        setRegister(5, 0x76); // Sprite Attribute table at 0x3B00
+        setRegister(6, 0x03); // Sprites Pattern Table at 0x1800
+        beginWriteBurst(name_table); // Init name table
         for (uint8_t j = 0; j < 24; j++)
             for (uint16_t i = 0; i < 32; i++)
-                writeByteToVRAM(i + 32 * (j / 4));
-      
+                writeBurstByte(i + 32 * (j / 4));
+        endWriteBurst();
         break;
     default:
         return VDP_ERROR; // Unsupported mode
@@ -281,6 +1215,8 @@ int vdp_init(uint8_t mode, uint8_t color, bool big_sprites, bool magnify)
     //vdp_set_bdcolor(VDP_WHITE);
     //vdp_textcolor(VDP_BLACK);
     setRegister(7, color);
+    setRegister(1, r1);
+    updateIE();
 
     /*setWriteAddress(sprite_attribute_table);
     for(uint16_t i = 0; i<128; i++)
@@ -288,144 +1224,152 @@ int vdp_init(uint8_t mode, uint8_t color, bool big_sprites, bool magnify)
     return VDP_OK;
 }
 
+// Control lines inactive. Leaves the VDP and VRAM as they are
+void initPins()
+{
+    pinMode(MODE, OUTPUT);
+    pinMode(RESET, OUTPUT);
+    pinMode(CSW, OUTPUT);
+    pinMode(CSR, OUTPUT);
+
+    Pins::Reset::high();
+    Pins::Mode::high();
+    Pins::Csw::high();
+    Pins::Csr::high();
+}
+
+int vdp_init(uint8_t mode, uint8_t color, bool big_sprites, bool magnify)
+{
+    VDP_API(vdp_init);
+    initPins();
+    reset();
+#ifdef RAMTEST
+    if (vdp_diag_march(NULL, 1) != VDP_OK)
+        return VDP_ERROR;
+#endif
+    return setMode(mode, color, big_sprites, magnify, true);
+}
+
+int vdp_set_mode(uint8_t mode, uint8_t color, bool big_sprites, bool magnify)
+{
+    VDP_API(vdp_set_mode);
+    initPins();
+    return setMode(mode, color, big_sprites, magnify, false);
+}
+
 void vdp_colorize(uint8_t fg, uint8_t bg)
 {
+    VDP_API(vdp_colorize);
     if (vdp_mode != VDP_MODE_G2)
         return;
-    uint16_t name_offset = cursor.y * (crsr_max_x + 1) + cursor.x; // Position in name table
-    uint16_t color_offset = name_offset << 3;                      // Offset of pattern in pattern table
-    setWriteAddress(color_table + color_offset);
-    for (uint8_t i = 0; i < 8; i++)
-        writeByteToVRAM((fg << 4) + bg);
+#if VDP_TILE_CACHE
+    if (tile_cache)
+    {
+        uint16_t name_offset = Vdp<VDP_MODE_G2>::cell(cursor.x, cursor.y);
+        uint8_t third = name_offset >> 8;
+        uint8_t pattern = peekVRAM(name_table + name_offset);
+        if (testBit(tile_cached[third], pattern))
+        {
+            tileWrite(name_offset, tileEntry(third, pattern)->key >> 8, (fg << 4) + bg);
+            return;
+        }
+        // Pattern of its own
+        Vdp<VDP_MODE_G2>::colorize(pattern & 31, (third << 3) + (pattern >> 5), fg, bg);
+        return;
+    }
+#endif
+    Vdp<VDP_MODE_G2>::colorize(cursor.x, cursor.y, fg, bg);
 }
 
 void vdp_plot_hires(uint8_t x, uint8_t y, uint8_t color1, uint8_t color2)
 {
+    VDP_API(vdp_plot_hires);
+    vdp_plot_hires_mask(x, y, 0x80 >> (x % 8), color1, color2);
+}
+
+void vdp_plot_hires_mask(uint8_t x, uint8_t y, uint8_t mask, uint8_t color1, uint8_t color2)
+{
+    VDP_API(vdp_plot_hires_mask);
     uint16_t offset = 8 * (x / 8) + y % 8 + 256 * (y / 8);
-    setReadAddress(pattern_table + offset);
-    uint8_t pixel = readByteFromVRAM();
-    setReadAddress(color_table + offset);
-    uint8_t color = readByteFromVRAM();
-    if(color1 != NULL)
+    uint8_t color = peekVRAM(color_table + offset);
+    if (color1 != 0)
     {
-        pixel |= 0x80 >> (x % 8); //Set a "1"
-        color = (color & 0x0F) | (color1 << 4); 
+        color = (color & 0x0F) | (color1 << 4);
+        if (mask == 0xFF) // The old pattern does not matter
+            storeVRAM(pattern_table + offset, &mask, 1);
+        else
+            pokeVRAM(pattern_table + offset, peekVRAM(pattern_table + offset) | mask); //Set "1"s
     }
     else
     {
-        pixel &= ~(0x80 >> (x % 8)); //Set bit as "0"
         color = (color & 0xF0) | (color2 & 0x0F);
+        uint8_t pixel = 0;
+        if (mask == 0xFF)
+            storeVRAM(pattern_table + offset, &pixel, 1);
+        else
+            pokeVRAM(pattern_table + offset, peekVRAM(pattern_table + offset) & ~mask); //Set bits as "0"
     }
-    setWriteAddress(pattern_table + offset);
-    writeByteToVRAM(pixel);
-    setWriteAddress(color_table + offset);
-    writeByteToVRAM(color);
+    pokeVRAM(color_table + offset, color);
 }
 
 void vdp_plot_color(uint8_t x, uint8_t y, uint8_t color)
 {
+    VDP_API(vdp_plot_color);
     if (vdp_mode == VDP_MODE_MULTICOLOR)
-    {
-        uint16_t addr = pattern_table + 8 * (x / 2) + y % 8 + 256 * (y / 8);
-        setReadAddress(addr);
-        uint8_t dot = readByteFromVRAM();
-        setWriteAddress(addr);
-        if (x & 1) // Odd columns
-            writeByteToVRAM((dot & 0xF0) + (color & 0x0f));
-        else
-            writeByteToVRAM((dot & 0x0F) + (color << 4));
-    }
+        Vdp<VDP_MODE_MULTICOLOR>::plot_color(x, y, color);
     else if (vdp_mode == VDP_MODE_G2)
-    {
-        // Draw bitmap
-        uint16_t offset = 8 * (x / 2) + y % 8 + 256 * (y / 8);
-        setReadAddress(color_table + offset);
-        uint8_t color_ = readByteFromVRAM();
-        if((x & 1) == 0) //Even 
-        {
-            color_ &= 0x0F; 
-            color_ |= (color << 4);
-        }
-        else
-        {
-            color_ &= 0xF0;
-            color_ |= color & 0x0F;
-        }
-        setWriteAddress(pattern_table + offset);
-        writeByteToVRAM(0xF0);
-        setWriteAddress(color_table + offset);
-        writeByteToVRAM(color_);
-        // Colorize
-    }
+        Vdp<VDP_MODE_G2>::plot_color(x, y, color);
 }
 
 void vdp_set_sprite_pattern(uint8_t number, const uint8_t *sprite)
 {
+    VDP_API(vdp_set_sprite_pattern);
 
     if(sprite_size_sel)
-    {
-        setWriteAddress(sprite_pattern_table + 32*number);
-        for (uint8_t i = 0; i<32; i++)
-        {
-            writeByteToVRAM(sprite[i]);
-        }
-    }
+        vdp_write_block(sprite_pattern_table + 32*number, sprite, 32);
     else
-    {
-        setWriteAddress(sprite_pattern_table + 8*number);
-        for (uint8_t i = 0; i<8; i++)
-        {
-            writeByteToVRAM(sprite[i]);
-        }
-    }
-
+        vdp_write_block(sprite_pattern_table + 8*number, sprite, 8);
 }
 
 void vdp_sprite_color(uint16_t addr, uint8_t color)
 {
-    setReadAddress(addr + 3);
-    uint8_t ecclr = readByteFromVRAM() & 0x80 | (color & 0x0F);
-    setWriteAddress(addr + 3);
-    writeByteToVRAM(ecclr);
+    VDP_API(vdp_sprite_color);
+    uint8_t ecclr = (peekVRAM(addr + 3) & 0x80) | (color & 0x0F);
+    pokeVRAM(addr + 3, ecclr);
 }
 
 Sprite_attributes vdp_sprite_get_attributes(uint16_t addr)
 {
+    VDP_API(vdp_sprite_get_attributes);
     Sprite_attributes attrs;
-    setReadAddress(addr);
-    attrs.y = readByteFromVRAM();
-    attrs.x = readByteFromVRAM();
-    attrs.name_ptr = readByteFromVRAM();
-    attrs.ecclr = readByteFromVRAM();
+    attrs.y = peekVRAM(addr);
+    attrs.x = peekVRAM(addr + 1);
+    attrs.name_ptr = peekVRAM(addr + 2);
+    attrs.ecclr = peekVRAM(addr + 3);
     return attrs;
 }
 
 void vdp_sprite_get_position(uint16_t addr, uint16_t &xpos, uint8_t &ypos)
 {
-    setReadAddress(addr);
-    ypos = readByteFromVRAM();
-    uint8_t x = readByteFromVRAM();
-    readByteFromVRAM();
-    uint8_t eccr = readByteFromVRAM();
+    VDP_API(vdp_sprite_get_position);
+    ypos = peekVRAM(addr);
+    uint8_t x = peekVRAM(addr + 1);
+    uint8_t eccr = peekVRAM(addr + 3);
     xpos = eccr & 0x80 ? x : x+32;
 }
 
 uint16_t vdp_sprite_init(uint8_t name, uint8_t priority, uint8_t color)
 {
+    VDP_API(vdp_sprite_init);
     uint16_t addr = sprite_attribute_table + 4*priority;
-    setWriteAddress(addr);
-    writeByteToVRAM(0); 
-    writeByteToVRAM(0);
-    if(sprite_size_sel)
-        writeByteToVRAM(4*name);
-    else
-        writeByteToVRAM(4*name);
-    writeByteToVRAM(0x80 | (color & 0xF));
+    uint8_t attrs[4] = {0, 0, (uint8_t)(4*name), (uint8_t)(0x80 | (color & 0xF))};
+    storeVRAM(addr, attrs, 4);
     return addr;
 }
 
 uint8_t vdp_sprite_set_position(uint16_t addr, uint16_t x, uint8_t y)
 {
+    VDP_API(vdp_sprite_set_position);
     uint8_t ec, xpos;
     if (x < 144)
     {
@@ -437,63 +1381,324 @@ uint8_t vdp_sprite_set_position(uint16_t addr, uint16_t x, uint8_t y)
         ec = 0;
         xpos = x-32;
     }
-    setReadAddress(addr + 3);
-    uint8_t color = readByteFromVRAM() & 0x0f;
+    uint8_t attrs[4] = {y, xpos, peekVRAM(addr + 2), (uint8_t)((ec << 7) | (peekVRAM(addr + 3) & 0x0f))};
+    pokeVRAM(addr, attrs, 4);
+    return spriteStatus();
+}
+
+uint8_t vdp_sprite_height()
+{
+    return ((reg1 & R1_SIZE) ? 16 : 8) << (reg1 & R1_MAG);
+}
 
-    setWriteAddress(addr);
-    writeByteToVRAM(y);
-    writeByteToVRAM(xpos);
-    setWriteAddress(addr + 3);
-    writeByteToVRAM((ec << 7) | color);
-    return read_status_reg();
+uint8_t vdp_sprite_write_table(uint8_t first, const uint8_t *attrs, uint8_t count)
+{
+    VDP_API(vdp_sprite_write_table);
+    if (count)
+        storeVRAM(sprite_attribute_table + 4 * first, attrs, 4 * count);
+    return spriteStatus();
 }
 
-void vdp_print(String text)
+#define SPRITE_TERMINATOR 0xD0 // Y position that ends the sprite attribute table
+#define SPRITE_HIDDEN 0xC0     // Y position below the screen
+
+VdpSpriteTable::VdpSpriteTable()
 {
-    for (uint16_t i = 0; text[i]; i++)
+    memset(attrs, 0, sizeof(attrs));
+    count = 0;
+    first = 32;
+    last = 0;
+    terminate(0);
+}
+
+void VdpSpriteTable::touch(uint8_t sprite)
+{
+    if (sprite < first)
+        first = sprite;
+    if (sprite > last)
+        last = sprite;
+}
+
+// Move the end of the table. Sprites that become part of the table are hidden
+void VdpSpriteTable::terminate(uint8_t new_count)
+{
+    for (uint8_t i = count; i < new_count; i++)
+    {
+        attrs[i][0] = SPRITE_HIDDEN;
+        touch(i);
+    }
+    count = new_count;
+    if (count < 32)
     {
-        switch (text[i])
+        attrs[count][0] = SPRITE_TERMINATOR;
+        touch(count);
+    }
+}
+
+void VdpSpriteTable::set_position(uint8_t sprite, uint16_t x, uint8_t y)
+{
+    sprite &= 31;
+    if (sprite >= count)
+        terminate(sprite + 1);
+    if (y == SPRITE_TERMINATOR)
+        y++; // Also below the screen
+    attrs[sprite][0] = y;
+    if (x < 144)
+    {
+        attrs[sprite][1] = x;
+        attrs[sprite][3] |= 0x80;
+    }
+    else
+    {
+        attrs[sprite][1] = x - 32;
+        attrs[sprite][3] &= ~0x80;
+    }
+    touch(sprite);
+}
+
+void VdpSpriteTable::set_color(uint8_t sprite, uint8_t color)
+{
+    sprite &= 31;
+    attrs[sprite][3] = (attrs[sprite][3] & 0x80) | (color & 0x0F);
+    touch(sprite);
+}
+
+void VdpSpriteTable::set_pattern(uint8_t sprite, uint8_t name)
+{
+    sprite &= 31;
+    attrs[sprite][2] = sprite_size_sel ? name << 2 : name;
+    touch(sprite);
+}
+
+void VdpSpriteTable::hide(uint8_t sprite)
+{
+    sprite &= 31;
+    if (sprite >= count)
+        return;
+    attrs[sprite][0] = SPRITE_HIDDEN;
+    touch(sprite);
+    uint8_t n = count;
+    while (n > 0 && attrs[n - 1][0] == SPRITE_HIDDEN)
+        n--;
+    if (n < count)
+        terminate(n);
+}
+
+Sprite_attributes VdpSpriteTable::get_attributes(uint8_t sprite)
+{
+    Sprite_attributes a;
+    sprite &= 31;
+    a.y = attrs[sprite][0];
+    a.x = attrs[sprite][1];
+    a.name_ptr = attrs[sprite][2];
+    a.ecclr = attrs[sprite][3];
+    return a;
+}
+
+uint8_t VdpSpriteTable::commit()
+{
+    VDP_API(sprite_table_commit);
+    uint8_t n = first <= last ? last - first + 1 : 0;
+    uint8_t status = vdp_sprite_write_table(first, attrs[first < 32 ? first : 0], n);
+    first = 32;
+    last = 0;
+    return status;
+}
+
+// State of the escape sequence parser of vdp_print()
+struct
+{
+    uint8_t state; // 0: Text, 1: After \033, 2: In the colors
+    uint8_t colors[2];
+    uint8_t index; // Color being parsed
+} esc;
+
+// Characters printed but not yet written: They are written to consecutive cells in one burst
+uint8_t run[40];
+uint8_t run_len;
+uint16_t run_offset; // Position of the first character in the name table
+
+void flushRun()
+{
+    if (!run_len)
+        return;
+    if (vdp_mode == VDP_MODE_G2)
+    {
+        uint16_t offset = run_offset << 3;
+        uint8_t color = (fgcolor << 4) + bgcolor;
+#if VDP_SHADOW != VDP_SHADOW_NONE
+        if (double_buffer)
         {
-        case '\n':
-            vdp_set_cursor(cursor.x, ++cursor.y);
-            break;
-        case '\r':
-            vdp_set_cursor(0, cursor.y);
-            break;
-        case '\033':
+            uint8_t cell[8];
+            for (uint8_t i = 0; i < run_len; i++, offset += 8)
+            {
+                memcpy_P(cell, ASCII + ((run[i] - 32) << 3), 8);
+                storeVRAM(pattern_table + offset, cell, 8);
+                memset(cell, color, 8);
+                storeVRAM(color_table + offset, cell, 8);
+            }
+            run_len = 0;
+            return;
+        }
+#endif
+        beginWriteBurst(pattern_table + offset);
+        for (uint8_t i = 0; i < run_len; i++)
+        {
+            const uint8_t *glyph = ASCII + ((run[i] - 32) << 3);
+            for (uint8_t j = 0; j < 8; j++)
+                writeBurstByte(pgm_read_byte(glyph + j));
+        }
+        endWriteBurst();
+        vdp_fill(color_table + offset, color, run_len << 3);
+    }
+    else // G1 and text mode
+        storeVRAM(name_table + run_offset, run, run_len);
+    run_len = 0;
+}
+
+// Print a character, parsing \033[<fg>;<bg>m sequences on the fly. Call flushRun() at the end
+void printChar(char c)
+{
+    switch (esc.state)
+    {
+    case 1: // Skip the [
+        esc.state = 2;
+        esc.colors[0] = esc.colors[1] = 0;
+        esc.index = 0;
+        return;
+    case 2:
+        if (c >= '0' && c <= '9')
+            esc.colors[esc.index] = esc.colors[esc.index] * 10 + c - '0';
+        else if (c == ';')
+            esc.index = 1;
+        else
         {
-            // Serial.println("Color Change");
-            String c = text.substring(i + 2, text.indexOf("m", i));
-            uint8_t fc = c.toInt();
-            uint8_t bc = 0;
-            if (c.indexOf(";") > 0)
-                bc = c.substring(c.indexOf(";") + 1).toInt();
-            vdp_textcolor(fc, bc);
-            text.remove(i, c.length() + 3);
-            i--;
+            esc.state = 0;
+            if (c == 'm')
+                vdp_textcolor(esc.colors[0], esc.colors[1]);
         }
+        return;
+    }
+    switch (c)
+    {
+    case '\n':
+        flushRun();
+        vdp_set_cursor(cursor.x, ++cursor.y);
         break;
-        default:
-            vdp_write(text[i]);
-            vdp_colorize(fgcolor, bgcolor);
+    case '\r':
+        flushRun();
+        vdp_set_cursor(0, cursor.y);
+        break;
+    case '\033':
+        flushRun(); // Before the colors change
+        esc.state = 1;
+        break;
+    default:
+#if VDP_TILE_CACHE
+        if (tile_cache) // Every character is looked up on its own
+        {
+            vdp_write(c);
             vdp_set_cursor(VDP_CSR_RIGHT);
+            break;
         }
+#endif
+        if (vdp_mode == VDP_MODE_G2 && ((uint8_t)c < 32 || (uint8_t)c > 127))
+            c = ' '; // No glyph
+        if (!run_len)
+            run_offset = cursor.y * (crsr_max_x + 1) + cursor.x;
+        run[run_len++] = c;
+        vdp_set_cursor(VDP_CSR_RIGHT);
+        if (cursor.x == 0) // The run ends with the row
+            flushRun();
     }
 }
 
+void vdp_print(const char *text)
+{
+    VDP_API(vdp_print);
+    while (*text)
+        printChar(*text++);
+    flushRun();
+}
+
+void vdp_print_P(PGM_P text)
+{
+    VDP_API(vdp_print);
+    char c;
+    while ((c = pgm_read_byte(text++)))
+        printChar(c);
+    flushRun();
+}
+
+void vdp_print(const __FlashStringHelper *text)
+{
+    vdp_print_P((PGM_P)text);
+}
+
+void vdp_print(const String &text)
+{
+    vdp_print(text.c_str());
+}
+
+size_t VdpText::write(uint8_t c)
+{
+    VDP_API(vdp_text);
+    printChar(c);
+    flushRun();
+    return 1;
+}
+
+size_t VdpText::write(const uint8_t *buffer, size_t size)
+{
+    VDP_API(vdp_text);
+    for (size_t i = 0; i < size; i++)
+        printChar(buffer[i]);
+    flushRun();
+    return size;
+}
+
+VdpText vdp_text;
+
+#ifdef __AVR__
+static int printfPut(char c, FILE *)
+{
+    printChar(c);
+    return 0;
+}
+#endif
+
+void vdp_printf(const char *format, ...)
+{
+    VDP_API(vdp_printf);
+    va_list args;
+    va_start(args, format);
+#ifdef __AVR__
+    // avr-libc formats into a stream, so the text goes to VRAM without a buffer
+    FILE stream;
+    fdev_setup_stream(&stream, printfPut, NULL, _FDEV_SETUP_WRITE);
+    vfprintf(&stream, format, args);
+    flushRun();
+#else
+    char text[VDP_PRINTF_SIZE];
+    vsnprintf(text, sizeof(text), format, args);
+    vdp_print(text);
+#endif
+    va_end(args);
+}
+
 void vdp_set_bdcolor(uint8_t color)
 {
+    VDP_API(vdp_set_bdcolor);
     setRegister(7, color);
 }
 
 void vdp_set_pattern_color(uint16_t index, uint8_t fg, uint8_t bg)
 {
+    VDP_API(vdp_set_pattern_color);
     if (vdp_mode == VDP_MODE_G1)
-    {
-        index &= 31;
-    }
-    setWriteAddress(color_table + index);
-    writeByteToVRAM((fg << 4) + bg);
+        Vdp<VDP_MODE_G1>::set_pattern_color(index, fg, bg);
+    else if (vdp_mode == VDP_MODE_G2)
+        Vdp<VDP_MODE_G2>::set_pattern_color(index, fg, bg);
 }
 
 void vdp_set_cursor(uint8_t col, uint8_t row)
@@ -543,6 +1748,7 @@ void vdp_set_cursor(uint8_t direction)
 
 void vdp_textcolor(uint8_t fg, uint8_t bg)
 {
+    VDP_API(vdp_textcolor);
     fgcolor = fg;
     bgcolor = bg;
     if (vdp_mode == VDP_MODE_TEXT)
@@ -551,22 +1757,20 @@ void vdp_textcolor(uint8_t fg, uint8_t bg)
 
 void vdp_write(uint8_t chr)
 {
-    uint16_t name_offset = cursor.y * (crsr_max_x + 1) + cursor.x; // Position in name table
-    uint16_t pattern_offset = name_offset << 3;                    // Offset of pattern in pattern table
-    if (vdp_mode == VDP_MODE_G2)
+    VDP_API(vdp_write);
+#if VDP_TILE_CACHE
+    if (tile_cache)
     {
-        setWriteAddress(pattern_table + pattern_offset);
-        for (uint8_t i = 0; i < 8; i++)
-        {
-            // writeByteToVRAM(patterns[((chr - 32) << 3) + i]);
-            writeByteToVRAM(pgm_read_byte(ASCII + (((chr - 32) << 3) + i)));
-        }
-    }
-    else // G1 and text mode
-    {
-        setWriteAddress(name_table + name_offset);
-        writeByteToVRAM(chr);
+        tileWrite(Vdp<VDP_MODE_G2>::cell(cursor.x, cursor.y), chr, (fgcolor << 4) + bgcolor);
+        return;
     }
+#endif
+    if (vdp_mode == VDP_MODE_G2)
+        Vdp<VDP_MODE_G2>::write(cursor.x, cursor.y, chr);
+    else if (vdp_mode == VDP_MODE_TEXT)
+        Vdp<VDP_MODE_TEXT>::write(cursor.x, cursor.y, chr);
+    else // G1 and Multicolor: Same name table
+        Vdp<VDP_MODE_G1>::write(cursor.x, cursor.y, chr);
 }
 
 //Wrapper functions
@@ -12,6 +12,7 @@
 #define VDP_H
 #include "Arduino.h"
 #include <avr/pgmspace.h>
+#include "vdp_instrument.h"
 
 enum VDP_COLORS
 {
@@ -54,6 +55,7 @@ enum VDP_CSR
  */
 #define VDP_FLAG_COIN 0x20 /*Coincidence flag, set when sprites overlap*/
 #define VDP_FLAG_S5 0x40  /*5th sprite flag, set when more than 4 sprite per line */
+#define VDP_FLAG_FRAME 0x80 /*Frame flag, set at the start of the vertical blank */
 
 /** Struct
  * @brief 4-Byte record defining sprite attributes
@@ -84,6 +86,17 @@ typedef struct
  */
 int vdp_init(uint8_t mode, uint8_t color, bool big_sprites, bool magnify);
 
+/**
+ * @brief Set up a mode like vdp_init(), but without a reset of the VDP and without clearing VRAM.
+ * Use it when VRAM still holds the screen, e.g. after a restart of the Arduino alone, which then keeps its picture.
+ * Only what the mode cannot work without is written: The font in Graphics Mode 1 and Text mode, the name table in
+ * Graphics Mode 2 and Multicolor mode. The display is off meanwhile.
+ *
+ * @param mode VDP_MODE_G1 | VDP_MODE_G2 | VDP_MODE_MULTICOLOR | VDP_MODE_TEXT
+ * @returns VDP_ERROR | VDP_SUCCESS
+ */
+int vdp_set_mode(uint8_t mode, uint8_t color, bool big_sprites, bool magnify);
+
 /**
  * @brief Initializes the VDP in text mode
  * 
@@ -122,6 +135,131 @@ int vdp_init_g2(bool big_sprites = 1, bool scale_sprites = false);
 int vdp_init_multicolor();
 
 
+/**
+ * @brief VRAM address of the pattern generator table, as set by vdp_init()
+ */
+uint16_t vdp_pattern_table();
+
+/**
+ * @brief VRAM address of the color table, as set by vdp_init()
+ */
+uint16_t vdp_color_table();
+
+/**
+ * @brief VRAM address of the name table, as set by vdp_init()
+ */
+uint16_t vdp_name_table();
+
+/**
+ * @brief Mode set by vdp_init(), one of VDP_MODES
+ */
+uint8_t vdp_screen_mode();
+
+/**
+ * @brief The font in program memory. 8 bytes for each of the 96 characters from 32 (space) to 127
+ */
+const uint8_t *vdp_font();
+
+/**
+ * @brief Copy a block of data from RAM into VRAM.
+ * The address is set once and the VDP increments it with every byte. Use it for all bulk transfers.
+ *
+ * @param addr VRAM address 0x0000 - 0x3FFF
+ * @param src Data to copy
+ * @param len Number of bytes
+ */
+void vdp_write_block(uint16_t addr, const uint8_t *src, uint16_t len);
+
+/**
+ * @brief Same as vdp_write_block(), but src is located in program memory (PROGMEM)
+ *
+ * @param addr VRAM address 0x0000 - 0x3FFF
+ * @param src Data to copy in program memory
+ * @param len Number of bytes
+ */
+void vdp_write_block_P(uint16_t addr, const uint8_t *src, uint16_t len);
+
+/**
+ * @brief Fill a block of VRAM with a value
+ *
+ * @param addr VRAM address 0x0000 - 0x3FFF
+ * @param value
+ * @param len Number of bytes
+ */
+void vdp_fill(uint16_t addr, uint8_t value, uint16_t len);
+
+/**
+ * @brief Copy a block of VRAM into RAM
+ *
+ * @param addr VRAM address 0x0000 - 0x3FFF
+ * @param dst Buffer of at least len bytes
+ * @param len Number of bytes
+ */
+void vdp_read_block(uint16_t addr, uint8_t *dst, uint16_t len);
+
+/**
+ * @brief Switch double buffering on or off.
+ * While on, the drawing functions write into the shadow VRAM in RAM and mark the changed 8 byte cells. vdp_flush() transfers them.
+ * Bulk transfers with vdp_write_block() and vdp_fill() are not buffered.
+ * With the line cache of the Uno and Nano (VDP_SHADOW_TILES) the sprite attribute table and VDP_SHADOW_LINES lines are buffered,
+ * lines evicted from the cache are written immediately. Switching off flushes. vdp_init() switches it off.
+ *
+ * @param enable
+ * @returns VDP_ERROR if the library is compiled without shadow VRAM (VDP_SHADOW=0)
+ */
+int vdp_double_buffer(bool enable);
+
+/**
+ * @brief Write the cells changed since the last call to VRAM. Adjacent cells are written in a single burst.
+ *
+ * @param wait_vblank Wait for the frame flag and start writing in the vertical blank. There the VDP accepts bytes four times faster and the screen does not tear.
+ */
+void vdp_flush(bool wait_vblank = true);
+
+/**
+ * @brief Job for the vertical blank service, see vdp_queue()
+ */
+typedef void (*VdpJob)(void *arg);
+
+/**
+ * @brief Switch the vertical blank service on or off. It sets the interrupt enable bit of the VDP, also after vdp_init().
+ * With VDP_INT_PIN defined in vdp_pins.h the end of the frame is detected by an interrupt handler,
+ * otherwise the frame flag of the status register is polled.
+ *
+ * @param enable
+ * @param budget Maximum number of VRAM bytes written by the jobs of one frame. 0: What fits into the vertical blank
+ */
+void vdp_vblank_service(bool enable, uint16_t budget = 0);
+
+/**
+ * @brief Queue a job that writes to VRAM. vdp_service() runs it in the vertical blank.
+ *
+ * @param job Function to call
+ * @param arg Passed to job
+ * @param bytes Number of VRAM bytes the job writes, 2 more for each address setup
+ * @returns false if the queue is full
+ */
+bool vdp_queue(VdpJob job, void *arg, uint16_t bytes);
+
+/**
+ * @brief Call from loop(). At the end of a frame, runs the queued jobs in order until the budget of the frame is used up.
+ * The jobs that fit into the vertical blank use the fast access window of the VDP.
+ *
+ * @param wait true: Wait for the end of the frame false: Return immediately if no frame has ended since the last call
+ * @returns Number of jobs run, -1 if no frame has ended
+ */
+int vdp_service(bool wait = true);
+
+/**
+ * @brief Number of frames seen by vdp_service() and vdp_flush()
+ */
+uint16_t vdp_frame_count();
+
+/**
+ * @brief VRAM bytes of the jobs run in the current frame
+ */
+uint16_t vdp_frame_bytes();
+
 /**
  * @brief Set foreground and background color of the pattern at the current cursor position
  * Only available in Graphic mode 2
@@ -142,6 +280,15 @@ void vdp_colorize(uint8_t fgcolor, uint8_t bgcolor);
  */
 void vdp_plot_hires(uint8_t x, uint8_t y, uint8_t color1, uint8_t color2 = 0);
 
+/**
+ * @brief Same as vdp_plot_hires() for all pixels of a byte of the pattern table at once, with a single read-modify-write.
+ * Used by the drawing functions of vdp_gfx.h
+ *
+ * @param x Any of the 8 pixels
+ * @param mask Pixels to plot, the most significant bit is the leftmost pixel
+ */
+void vdp_plot_hires_mask(uint8_t x, uint8_t y, uint8_t mask, uint8_t color1, uint8_t color2 = 0);
+
 /**
  * @brief Plot a point at position (x,y), where x <= 64. In Graphics mode2, the resolution is 64 by 192 pixels, neighboring pixels can have different colors.
  * In Multicolor  mode, the resolution is 64 by 48 pixels
@@ -153,16 +300,58 @@ void vdp_plot_hires(uint8_t x, uint8_t y, uint8_t color1, uint8_t color2 = 0);
 void vdp_plot_color(uint8_t x, uint8_t y, uint8_t color);
 
 /**
- * @brief Print string at current cursor position. These Escape sequences are supported:
+ * @brief Print string at current cursor position. The characters up to the end of a row, a control character or an escape sequence
+ * are written in one burst. These Escape sequences are supported:
  * <ul>
  * <li>\\n (newline) </li>
  * <li>\\r (carriage return)</li>
  * <li>Graphic Mode 2 only: \\033[<fg>;[<bg>]m sets the colors and optionally the background of the subsequent characters </li>
  * </ul>
  * Example: vdp_print("\033[4m Dark blue on transparent background\n\r\033[4;14m dark blue on gray background");
+ * The text is not copied, an escape sequence may also be split between calls.
  * @param text Text to print
  */
-void vdp_print(String);
+void vdp_print(const char *text);
+
+/**
+ * @brief Same as vdp_print(), but text is located in program memory, e.g. vdp_print_P(PSTR("Hello"))
+ */
+void vdp_print_P(PGM_P text);
+
+/**
+ * @brief Same as vdp_print(), for text in program memory with the F() macro
+ */
+void vdp_print(const __FlashStringHelper *text);
+
+/**
+ * @brief Same as vdp_print(const char *)
+ */
+void vdp_print(const String &text);
+
+/**
+ * @brief Size of the buffer of vdp_printf() where the C library cannot format into a stream
+ */
+#ifndef VDP_PRINTF_SIZE
+#define VDP_PRINTF_SIZE 64
+#endif
+
+/**
+ * @brief Formatted print, e.g. vdp_printf("%3d%%", percent). On AVR the text goes straight to VRAM without a buffer,
+ * elsewhere it is cut off after VDP_PRINTF_SIZE - 1 characters
+ */
+void vdp_printf(const char *format, ...);
+
+/**
+ * @brief Print of the Arduino core writing to the cursor position like vdp_print(), e.g. vdp_text.print(42, HEX)
+ */
+class VdpText : public Print
+{
+public:
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+};
+extern VdpText vdp_text;
 
 /**
  * @brief Set backdrop color
@@ -212,6 +401,18 @@ void vdp_textcolor(uint8_t fgcolor, uint8_t bgcolor = VDP_TRANSPARENT);
  */
 void vdp_write(uint8_t);
 
+/**
+ * @brief Switch the tile cache for text in Graphics Mode 2 on or off.
+ * While on, characters of the same glyph and colors share a pattern of their third of the screen. vdp_write() and vdp_print()
+ * write only a byte of the name table if the glyph is already on the screen, else the pattern and its colors once.
+ * vdp_write() uses the colors of vdp_textcolor(). If all entries for a glyph are on the screen, the cell gets a pattern of its own.
+ * The drawing functions like vdp_plot_hires() do not work while the cache is on. Switching off clears the screen. vdp_init() switches it off.
+ *
+ * @param enable
+ * @returns VDP_ERROR if not in Graphics Mode 2 or the library is compiled without tile cache (VDP_TILE_CACHE=0)
+ */
+int vdp_tile_cache(bool enable);
+
 /**
  * @brief Write a sprite into the sprite pattern table
  * 
@@ -261,8 +462,83 @@ uint16_t vdp_sprite_init(uint8_t name, uint8_t priority, uint8_t color = 0);
  * @param handle  Sprite Handle returned by vdp_sprite_init()
  * @param x 
  * @param y 
- * @returns     true: In case of a collision with other sprites
+ * @returns     Status register as returned by vdp_sprite_write_table(), VDP_FLAG_COIN in case of a collision with other sprites
  */
 uint8_t vdp_sprite_set_position(uint16_t handle, uint16_t x, uint8_t y);
 
+/**
+ * @brief Height of the sprites in pixels, as set by vdp_init(): 8, 16 or 32 with magnified 16x16 sprites
+ */
+uint8_t vdp_sprite_height();
+
+/**
+ * @brief Write the attributes of count sprites, starting with sprite first, in a single burst
+ *
+ * @param first Number of the first sprite 0-31
+ * @param attrs count 4-byte records y, x, name, early clock and color, as in the sprite attribute table
+ * @param count Number of sprites, 0: only read the status register
+ * @returns Status register, see VDP_FLAG_COIN and VDP_FLAG_S5. The sprite flags are collected from all reads of the
+ * status register since the last call of a sprite function, e.g. by the vertical blank service
+ */
+uint8_t vdp_sprite_write_table(uint8_t first, const uint8_t *attrs, uint8_t count);
+
+/**
+ * @brief Copy of the sprite attribute table in RAM.
+ * The set functions only change the copy, commit() writes the changed sprites to VRAM in a single burst.
+ * Sprites are numbered 0-31, 0 has the highest priority. The VDP only processes the sprites up to the highest one
+ * with a position, commit() terminates the table after it.
+ */
+class VdpSpriteTable
+{
+public:
+    VdpSpriteTable();
+
+    /**
+     * @brief Set the position of a sprite. Coordinates as in vdp_sprite_set_position(): For x < 144, the early clock bit
+     * is set and the sprite is shifted 32 pixels to the left, so it can enter the screen from the left edge.
+     *
+     * @param sprite 0-31
+     * @param x 0-287
+     * @param y
+     */
+    void set_position(uint8_t sprite, uint16_t x, uint8_t y);
+
+    /**
+     * @brief Set the sprite color
+     */
+    void set_color(uint8_t sprite, uint8_t color);
+
+    /**
+     * @brief Set the pattern of a sprite
+     *
+     * @param sprite 0-31
+     * @param name Reference of the pattern as in vdp_set_sprite_pattern()
+     */
+    void set_pattern(uint8_t sprite, uint8_t name);
+
+    /**
+     * @brief Move a sprite below the screen
+     */
+    void hide(uint8_t sprite);
+
+    /**
+     * @brief Get the attributes of a sprite
+     */
+    Sprite_attributes get_attributes(uint8_t sprite);
+
+    /**
+     * @brief Write the changes since the last commit() to VRAM
+     *
+     * @returns Status register as returned by vdp_sprite_write_table()
+     */
+    uint8_t commit();
+
+private:
+    uint8_t attrs[32][4];
+    uint8_t count;       // Number of sprites processed by the VDP
+    uint8_t first, last; // Sprites changed since the last commit. first > last: none
+    void touch(uint8_t sprite);
+    void terminate(uint8_t new_count);
+};
+
 #endif
\ No newline at end of file
@@ -0,0 +1,175 @@
+/**
+ * @file tmsimage.h
+ * @author Doctor Volt
+ * @brief TMS image format. Shared by the library and the imgserial tool, so it must not depend on Arduino.h
+ *
+ * A TMS image holds the 6k pattern table followed by the 6k color table of a 256x192 picture in Graphics Mode 2.
+ * It is copied into VRAM as it is, without any conversion on the Arduino.
+ *
+ * Header, 8 bytes: 'T', 'M', 'S', mode (TMS_IMAGE_G2), flags (TMS_IMAGE_RLE), 0, size of the data in bytes (little endian)
+ *
+ * RLE: Control byte n < 128: n + 1 literal bytes follow. n >= 128: The next byte is repeated n - 125 times (3 - 130)
+ *
+ * A stream of frames starts with a header of mode TMS_STREAM_G2 and size 0. The tables are divided into 8 byte cells,
+ * the 768 cells of the pattern table followed by the 768 cells of the color table. Each frame sends only the cells
+ * that changed since the previous one:
+ * Frame: flags (TMS_STREAM_KEY, TMS_STREAM_END), number of records (little endian), records
+ * Record: number of the first cell (little endian), number of cells (1 - 255), 8 bytes per cell.
+ * A record does not cross from the pattern table into the color table.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef TMSIMAGE_H
+#define TMSIMAGE_H
+#include <stdint.h>
+#include <stddef.h>
+
+#define TMS_IMAGE_HEADER_SIZE 8
+#define TMS_IMAGE_G2 1
+#define TMS_IMAGE_RLE 0x01
+#define TMS_IMAGE_TABLE_SIZE 6144
+#define TMS_IMAGE_SIZE (2 * TMS_IMAGE_TABLE_SIZE)
+#define TMS_STREAM_G2 2
+#define TMS_STREAM_KEY 0x01 // Keyframe: All cells follow
+#define TMS_STREAM_END 0x80 // End of the stream
+#define TMS_STREAM_CELLS (TMS_IMAGE_SIZE / 8)
+#define TMS_STREAM_FRAME_HEADER 3
+#define TMS_STREAM_RECORD_HEADER 3
+
+inline void tms_image_header(uint8_t *header, uint8_t flags, uint16_t size, uint8_t mode = TMS_IMAGE_G2)
+{
+    header[0] = 'T';
+    header[1] = 'M';
+    header[2] = 'S';
+    header[3] = mode;
+    header[4] = flags;
+    header[5] = 0;
+    header[6] = size & 0xFF;
+    header[7] = size >> 8;
+}
+
+/**
+ * @brief Check a header
+ * @returns false if it is not the header of a TMS image
+ */
+inline bool tms_image_check(const uint8_t *header, uint8_t &flags, uint16_t &size)
+{
+    if (header[0] != 'T' || header[1] != 'M' || header[2] != 'S' || header[3] != TMS_IMAGE_G2)
+        return false;
+    flags = header[4];
+    size = header[6] | (header[7] << 8);
+    return true;
+}
+
+/**
+ * @returns true if header starts a stream of frames
+ */
+inline bool tms_stream_check(const uint8_t *header)
+{
+    return header[0] == 'T' && header[1] == 'M' && header[2] == 'S' && header[3] == TMS_STREAM_G2;
+}
+
+/**
+ * @brief Pattern and color byte of 8 pixels. Only two colors are possible: The most frequent color becomes the foreground,
+ * the second most frequent the background. Pixels of other colors get the background color.
+ *
+ * @param pixels 8 colors
+ * @param color_offset Added to every color, e.g. 1 for palette indices of the tms9918.gpl Gimp palette
+ */
+inline void tms_image_cell(const uint8_t *pixels, uint8_t color_offset, uint8_t &pattern, uint8_t &color)
+{
+    uint8_t count[16] = {0};
+    uint8_t fg = (pixels[0] + color_offset) & 0x0F, bg = fg;
+    for (uint8_t i = 0; i < 8; i++)
+        count[(pixels[i] + color_offset) & 0x0F]++;
+    for (uint8_t c = 0; c < 16; c++)
+    {
+        if (count[c] > count[fg])
+        {
+            bg = fg;
+            fg = c;
+        }
+        else if (count[c] && c != fg && (bg == fg || count[c] > count[bg]))
+            bg = c;
+    }
+    pattern = 0;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        pattern <<= 1;
+        if (((pixels[i] + color_offset) & 0x0F) == fg)
+            pattern |= 1;
+    }
+    color = (fg << 4) | bg;
+}
+
+/**
+ * @brief State of the RLE decoder
+ */
+struct TmsRle
+{
+    uint8_t literals = 0; // Literal bytes still to come
+    uint8_t run = 0;      // Length of the run whose value comes next
+};
+
+/**
+ * @brief Decode one byte of RLE data
+ *
+ * @param in Byte of the data
+ * @param value Decoded value
+ * @returns How many times value is output, 0 for a control byte
+ */
+inline uint8_t tms_rle_decode(TmsRle &rle, uint8_t in, uint8_t &value)
+{
+    value = in;
+    if (rle.literals)
+    {
+        rle.literals--;
+        return 1;
+    }
+    if (rle.run)
+    {
+        uint8_t n = rle.run;
+        rle.run = 0;
+        return n;
+    }
+    if (in < 128)
+        rle.literals = in + 1;
+    else
+        rle.run = in - 125;
+    return 0;
+}
+
+/**
+ * @brief RLE compress a block of data
+ *
+ * @param out Buffer of at least len + len / 128 + 1 bytes
+ * @returns Size of the compressed data
+ */
+inline size_t tms_rle_encode(const uint8_t *in, size_t len, uint8_t *out)
+{
+    size_t i = 0, o = 0;
+    while (i < len)
+    {
+        size_t run = 1;
+        while (i + run < len && run < 130 && in[i + run] == in[i])
+            run++;
+        if (run >= 3)
+        {
+            out[o++] = run + 125;
+            out[o++] = in[i];
+            i += run;
+            continue;
+        }
+        // Literals up to the next run of 3
+        size_t n = 0;
+        while (i + n < len && n < 128 && !(i + n + 2 < len && in[i + n] == in[i + n + 1] && in[i + n] == in[i + n + 2]))
+            n++;
+        out[o++] = n - 1;
+        for (size_t k = 0; k < n; k++)
+            out[o++] = in[i++];
+    }
+    return o;
+}
+
+#endif
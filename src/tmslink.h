@@ -0,0 +1,83 @@
+/**
+ * @file tmslink.h
+ * @author Doctor Volt
+ * @brief Serial link between the imgserial tool and the g2image example. Shared by both, so it must not depend on Arduino.h
+ *
+ * The data is sent in frames: TMS_LINK_SOF, sequence number, length of the payload, payload, CRC-16 of sequence number,
+ * length and payload (little endian). The receiver answers every frame with two bytes:
+ * TMS_LINK_ACK and the sequence number of the next frame it expects, or TMS_LINK_NAK and the sequence number of the
+ * frame it expects if a frame is damaged or out of order, or if no frame arrives within its serial timeout.
+ *
+ * The receiver replies as soon as it has read a frame out of its receive buffer. The sender keeps up to
+ * TMS_LINK_CREDIT bytes unanswered, so the receive buffer of the Arduino never overflows while it writes to VRAM,
+ * and the next frames are already on the way. After a NAK or TMS_LINK_TIMEOUT without reply, the sender repeats all
+ * frames from the one the receiver expects (go back N). The replies to the frames that were still underway are
+ * ignored, only a NAK for a repeated frame makes the sender go back again.
+ * The sender gives up after TMS_LINK_RETRIES timeouts without progress, the receiver after as many serial timeouts.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef TMSLINK_H
+#define TMSLINK_H
+#include <stdint.h>
+
+#define TMS_LINK_SOF 0xA5
+#define TMS_LINK_ACK 'A'
+#define TMS_LINK_NAK 'N'
+#define TMS_LINK_PAYLOAD 24                        // Maximum payload of a frame
+#define TMS_LINK_FRAME (TMS_LINK_PAYLOAD + 5)      // Maximum size of a frame
+#define TMS_LINK_CREDIT 63                         // The serial receive buffer of the Arduino holds 63 bytes
+#define TMS_LINK_TIMEOUT 200                       // Time in ms the sender waits for a reply
+#define TMS_LINK_RETRIES 10                        // The sender gives up after as many timeouts in a row
+
+inline uint16_t tms_crc16(uint16_t crc, uint8_t data)
+{
+    crc ^= data << 8;
+    for (uint8_t i = 0; i < 8; i++)
+        crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+}
+
+/**
+ * @brief CRC-16/CCITT of sequence number, length and payload. frame points to the sequence number
+ */
+inline uint16_t tms_link_crc(const uint8_t *frame)
+{
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < frame[1] + 2; i++)
+        crc = tms_crc16(crc, frame[i]);
+    return crc;
+}
+
+/**
+ * @brief Build a frame
+ *
+ * @param frame Buffer of TMS_LINK_FRAME bytes
+ * @param len Size of the payload, up to TMS_LINK_PAYLOAD
+ * @returns Size of the frame
+ */
+inline uint8_t tms_link_frame(uint8_t *frame, uint8_t seq, const uint8_t *payload, uint8_t len)
+{
+    frame[0] = TMS_LINK_SOF;
+    frame[1] = seq;
+    frame[2] = len;
+    for (uint8_t i = 0; i < len; i++)
+        frame[3 + i] = payload[i];
+    uint16_t crc = tms_link_crc(frame + 1);
+    frame[3 + len] = crc & 0xFF;
+    frame[4 + len] = crc >> 8;
+    return len + 5;
+}
+
+/**
+ * @brief Check the CRC of a received frame
+ * @param frame Sequence number, length, payload and CRC, without TMS_LINK_SOF
+ */
+inline bool tms_link_check(const uint8_t *frame)
+{
+    uint16_t crc = tms_link_crc(frame);
+    return frame[frame[1] + 2] == (crc & 0xFF) && frame[frame[1] + 3] == crc >> 8;
+}
+
+#endif
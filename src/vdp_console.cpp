@@ -0,0 +1,234 @@
+/* Text console of the Arduino library for TMS9918A, TMS9928 and TMS9929A Video Display Processors
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "vdp_console.h"
+
+void VdpConsole::begin(uint8_t fg, uint8_t bg)
+{
+    VDP_API(console_begin);
+    uint8_t mode = vdp_screen_mode();
+    cols = mode == VDP_MODE_TEXT ? 40 : 32;
+    color = default_color = (fg << 4) | (bg & 0x0F);
+    memset(keys, 0, sizeof(keys));
+    victim = 0;
+    if (mode == VDP_MODE_G2)
+    {
+        // Same font and colors in all three thirds
+        for (uint16_t third = 0; third < 0x1800; third += 0x800)
+        {
+            vdp_write_block_P(vdp_pattern_table() + third + 0x100, vdp_font(), 768);
+            vdp_fill(vdp_color_table() + third + 0x100, default_color, 768);
+        }
+    }
+    else if (mode == VDP_MODE_G1)
+        vdp_fill(vdp_color_table(), default_color, 32);
+    else
+        vdp_textcolor(fg, bg);
+    clear();
+    flush();
+}
+
+void VdpConsole::clear()
+{
+    VDP_API(console_clear);
+    memset(names, ' ', sizeof(names));
+    top = 0;
+    x = y = 0;
+    wrap = false;
+    scrolled = true;
+}
+
+void VdpConsole::scroll()
+{
+    top = (top + 1) % VDP_CONSOLE_ROWS;
+    memset(row(VDP_CONSOLE_ROWS - 1), ' ', cols);
+    scrolled = true;
+}
+
+void VdpConsole::set_cursor(uint8_t col, uint8_t row)
+{
+    x = col < cols ? col : cols - 1;
+    y = row < VDP_CONSOLE_ROWS ? row : VDP_CONSOLE_ROWS - 1;
+    wrap = false;
+}
+
+void VdpConsole::set_color(uint8_t fg, uint8_t bg)
+{
+    color = (fg << 4) | (bg & 0x0F);
+}
+
+void VdpConsole::newline()
+{
+    if (y < VDP_CONSOLE_ROWS - 1)
+        y++;
+    else
+        scroll();
+}
+
+void VdpConsole::put(uint8_t c)
+{
+    switch (c)
+    {
+    case '\r':
+        x = 0;
+        wrap = false;
+        return;
+    case '\n':
+        wrap = false;
+        newline();
+        return;
+    case '\b':
+        if (wrap)
+            wrap = false;
+        else if (x)
+            x--;
+        return;
+    }
+    if (c < 32 || c > 127)
+        return;
+    if (wrap)
+    {
+        wrap = false;
+        x = 0;
+        newline();
+    }
+    row(y)[x] = name(c);
+    dirty |= 1UL << y;
+    if (x == cols - 1)
+        wrap = true;
+    else
+        x++;
+}
+
+size_t VdpConsole::write(uint8_t c)
+{
+    VDP_API(console_write);
+    put(c);
+    if (auto_flush)
+        flush();
+    return 1;
+}
+
+size_t VdpConsole::write(const uint8_t *buffer, size_t size)
+{
+    VDP_API(console_write);
+    for (size_t i = 0; i < size; i++)
+        put(buffer[i]);
+    if (auto_flush)
+        flush();
+    return size;
+}
+
+// Name of the pattern of c in the current color. Slot i has the name i + 128, which wraps around to 0 - 31 after 255
+uint8_t VdpConsole::name(uint8_t c)
+{
+    if (color == default_color || vdp_screen_mode() != VDP_MODE_G2)
+        return c;
+    uint16_t key = (color << 8) | c;
+    uint8_t slot = VDP_CONSOLE_SLOTS;
+    for (uint8_t i = 0; i < VDP_CONSOLE_SLOTS; i++)
+    {
+        if (keys[i] == key)
+            return i + 128;
+        if (!keys[i] && slot == VDP_CONSOLE_SLOTS)
+            slot = i;
+    }
+    if (slot == VDP_CONSOLE_SLOTS)
+    {
+        // Cache full: Evict a slot that is not on the screen
+        uint8_t used[32] = {0};
+        for (uint16_t i = 0; i < VDP_CONSOLE_ROWS * cols; i++)
+            used[names[i] >> 3] |= 1 << (names[i] & 7);
+        for (uint8_t i = 0; i < VDP_CONSOLE_SLOTS; i++)
+        {
+            uint8_t n = victim + 128;
+            if (++victim == VDP_CONSOLE_SLOTS)
+                victim = 0;
+            if (!(used[n >> 3] & (1 << (n & 7))))
+            {
+                slot = n - 128;
+                break;
+            }
+        }
+        if (slot == VDP_CONSOLE_SLOTS)
+            return c; // All slots on the screen, fall back to the default color
+    }
+    keys[slot] = key;
+    loadSlot(slot + 128, c, color);
+    return slot + 128;
+}
+
+void VdpConsole::loadSlot(uint8_t name, uint8_t c, uint8_t color)
+{
+    uint8_t glyph[8];
+    memcpy_P(glyph, vdp_font() + ((c - 32) << 3), 8);
+    for (uint16_t third = 0; third < 0x1800; third += 0x800)
+    {
+        vdp_write_block(vdp_pattern_table() + third + (name << 3), glyph, 8);
+        vdp_fill(vdp_color_table() + third + (name << 3), color, 8);
+    }
+}
+
+// Writes the name table, called by vdp_service() in the vertical blank
+void VdpConsole::flushJob(void *arg)
+{
+    VdpConsole *con = (VdpConsole *)arg;
+    uint16_t names = vdp_name_table();
+    if (con->scrolled)
+    {
+        // The ring from the top row to the end, then from the start to the top row
+        uint16_t head = (VDP_CONSOLE_ROWS - con->top) * con->cols;
+        vdp_write_block(names, con->row(0), head);
+        if (con->top)
+            vdp_write_block(names + head, con->names, con->top * con->cols);
+    }
+    else
+    {
+        for (uint8_t r = 0; r < VDP_CONSOLE_ROWS; r++)
+            if (con->dirty & (1UL << r))
+                vdp_write_block(names + r * con->cols, con->row(r), con->cols);
+    }
+    con->scrolled = false;
+    con->dirty = 0;
+    con->pending = false;
+}
+
+void VdpConsole::flush(bool wait_vblank)
+{
+    VDP_API(console_flush);
+    if (!scrolled && !dirty)
+        return;
+    if (!wait_vblank)
+    {
+        flushJob(this);
+        return;
+    }
+    uint16_t bytes = 4 + VDP_CONSOLE_ROWS * cols;
+    if (!scrolled)
+    {
+        bytes = 0;
+        for (uint8_t r = 0; r < VDP_CONSOLE_ROWS; r++)
+            if (dirty & (1UL << r))
+                bytes += cols + 2;
+    }
+    pending = true;
+    while (!vdp_queue(flushJob, this, bytes))
+        vdp_service();
+    while (pending)
+        vdp_service();
+}
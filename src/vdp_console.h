@@ -0,0 +1,109 @@
+/**
+ * @file vdp_console.h
+ * @author Doctor Volt
+ * @brief Scrolling text console for Text mode, Graphics Mode 1 and 2
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_CONSOLE_H
+#define VDP_CONSOLE_H
+#include "tms9918.h"
+
+/**
+ * @brief Patterns for characters in other than the default colors in Graphics Mode 2, up to 160
+ */
+#ifndef VDP_CONSOLE_SLOTS
+#define VDP_CONSOLE_SLOTS 160
+#endif
+#define VDP_CONSOLE_ROWS 24
+
+/**
+ * @brief Text console that scrolls up when the text passes the bottom of the screen.
+ * The name table is kept in a RAM ring buffer of 24 rows. Scrolling moves the start of the ring, and flush() writes
+ * the whole name table in one burst. Without scrolling only the changed rows are written.
+ *
+ * In Graphics Mode 2 the three thirds of the screen get the same patterns and colors, so the name of a character is
+ * the same in every row. The font is loaded once in the default colors. Characters in other colors get a pattern from a
+ * cache of VDP_CONSOLE_SLOTS patterns, which is loaded once per character and color. Scrolling does not rewrite patterns.
+ *
+ * Needs 960 bytes of RAM plus 2 bytes per slot.
+ */
+class VdpConsole : public Print
+{
+public:
+    /**
+     * @brief Take over the screen. Call vdp_init_textmode(), vdp_init_g1() or vdp_init_g2() first
+     *
+     * @param fg Default foreground color in Graphics Mode 2
+     * @param bg Default background color in Graphics Mode 2
+     */
+    void begin(uint8_t fg = VDP_WHITE, uint8_t bg = VDP_BLACK);
+
+    /**
+     * @brief Write a character at the cursor. '\r' moves the cursor to the start of the row, '\n' one row down,
+     * '\b' one column back. The cursor wraps to the next row when a character is written after the end of a row.
+     */
+    size_t write(uint8_t c) override;
+
+    /**
+     * @brief Write characters and flush() once at the end
+     */
+    size_t write(const uint8_t *buffer, size_t size) override;
+    using Print::write;
+
+    /**
+     * @brief Move the cursor
+     */
+    void set_cursor(uint8_t col, uint8_t row);
+
+    /**
+     * @brief Colors of the following characters. Graphics Mode 2 only
+     */
+    void set_color(uint8_t fg, uint8_t bg);
+
+    /**
+     * @brief Clear the screen and move the cursor to the top left corner
+     */
+    void clear();
+
+    /**
+     * @brief Scroll up by one row. The bottom row is cleared
+     */
+    void scroll();
+
+    /**
+     * @brief Write the changed rows to VRAM
+     *
+     * @param wait_vblank Write in the vertical blank, where the screen does not tear
+     */
+    void flush(bool wait_vblank = false);
+
+    /**
+     * @brief Flush after every write() call. On by default
+     */
+    void set_auto_flush(bool enable) { auto_flush = enable; }
+
+private:
+    uint8_t names[VDP_CONSOLE_ROWS * 40];
+    uint16_t keys[VDP_CONSOLE_SLOTS]; // Color and character of the cached patterns, 0: Free
+    uint8_t cols;
+    uint8_t top; // Row of the ring buffer shown at the top of the screen
+    uint8_t x, y;
+    bool wrap; // The last character was written to the end of the row
+    uint8_t color, default_color;
+    uint8_t victim; // Next slot to check for eviction
+    uint32_t dirty; // Changed rows of the screen
+    bool scrolled;  // Whole name table changed
+    bool auto_flush = true;
+    volatile bool pending;
+
+    uint8_t *row(uint8_t r) { return names + ((top + r) % VDP_CONSOLE_ROWS) * cols; }
+    void put(uint8_t c);
+    void newline();
+    uint8_t name(uint8_t c);
+    void loadSlot(uint8_t name, uint8_t c, uint8_t color);
+    static void flushJob(void *arg);
+};
+
+#endif
@@ -0,0 +1,144 @@
+/* Diagnostics of the Arduino library for TMS9918A, TMS9928 and TMS9929A Video Display Processors
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "vdp_diag.h"
+
+// Bus access of tms9918.cpp
+void setRegister(unsigned char registerIndex, unsigned char value);
+void shadowInvalidate();
+void diagWrite(uint16_t address, const uint8_t *src, uint16_t len, uint8_t strobe, uint8_t gap);
+void diagRead(uint16_t address, uint8_t *dst, uint16_t len, uint8_t strobe, uint8_t gap);
+
+#define R1_16K 0x80
+#define R1_DISPLAY 0x40
+
+// Delays in loops of 3 cycles, far above the data sheet: 3us strobe, 9us between accesses
+#define SAFE_STROBE (3 * (F_CPU / 1000000) / 3)
+#define SAFE_GAP (9 * (F_CPU / 1000000) / 3)
+// The March test runs with the display off: 2us between accesses, and with the safe strobe. It tests VRAM, not the bus
+#define MARCH_STROBE SAFE_STROBE
+#define MARCH_GAP (2 * (F_CPU / 1000000) / 3 + 1)
+#define SWEEP_MAX 64
+#define BLOCK 64 // Bytes of test data per pass
+// While the screen is drawn, passes must span more than a frame, so they do not all fall into the vertical blank
+#define ACTIVE_PASSES (VDP_DIAG_PASSES * 32)
+
+static const uint8_t backgrounds[] = {0x00, 0x55, 0x33, 0x0F};
+
+static void fillVRAM(uint8_t value)
+{
+    uint8_t block[BLOCK];
+    memset(block, value, BLOCK);
+    for (uint16_t addr = 0; addr < 0x4000; addr += BLOCK)
+        diagWrite(addr, block, BLOCK, MARCH_STROBE, MARCH_GAP);
+}
+
+// Read every byte, expecting value. For elements 1 - 4 the inverse is written after each read
+static bool marchElement(uint8_t element, bool down, uint8_t value, VdpMarchResult *result)
+{
+    uint8_t inverse = ~value;
+    for (uint16_t i = 0; i < 0x4000; i++)
+    {
+        uint16_t addr = down ? 0x3FFF - i : i;
+        uint8_t actual;
+        diagRead(addr, &actual, 1, MARCH_STROBE, MARCH_GAP);
+        if (actual != value)
+        {
+            if (result)
+            {
+                result->address = addr;
+                result->expected = value;
+                result->actual = actual;
+                result->element = element;
+            }
+            return false;
+        }
+        if (element < 5)
+            diagWrite(addr, &inverse, 1, MARCH_STROBE, MARCH_GAP);
+    }
+    return true;
+}
+
+int vdp_diag_march(VdpMarchResult *result, uint8_t n)
+{
+    VDP_API(vdp_diag_march);
+    setRegister(1, R1_16K); // Display off
+    shadowInvalidate();
+    for (uint8_t b = 0; b < n && b < sizeof(backgrounds); b++)
+    {
+        uint8_t d0 = backgrounds[b], d1 = ~d0;
+        fillVRAM(d0);
+        if (!marchElement(1, false, d0, result) || !marchElement(2, false, d1, result) ||
+            !marchElement(3, true, d0, result) || !marchElement(4, true, d1, result) ||
+            !marchElement(5, false, d0, result))
+        {
+            if (result)
+                result->background = d0;
+            return VDP_ERROR;
+        }
+    }
+    return VDP_OK;
+}
+
+// Write a block of test data and read it back, each with its own timing
+static bool pass(uint8_t n, uint8_t write_strobe, uint8_t write_gap, uint8_t read_strobe, uint8_t read_gap)
+{
+    uint8_t data[BLOCK], back[BLOCK];
+    for (uint8_t i = 0; i < BLOCK; i++)
+        data[i] = i * 37 + n * 11 + 0x5A;
+    diagWrite(0, data, BLOCK, write_strobe, write_gap);
+    diagRead(0, back, BLOCK, read_strobe, read_gap);
+    return !memcmp(data, back, BLOCK);
+}
+
+enum Parameter
+{
+    WRITE_STROBE,
+    READ_STROBE,
+    GAP
+};
+
+// Shortest delay for the parameter at which all passes succeed. The gap is measured with the strobes found before,
+// as they are part of the time between two accesses
+static bool sweep(Parameter param, uint16_t passes, VdpTiming &timing, uint8_t &delay)
+{
+    for (delay = 0; delay <= SWEEP_MAX; delay++)
+    {
+        uint16_t n = 0;
+        while (n < passes && (param == GAP ? pass(n, timing.strobe_write, delay, timing.strobe_read, delay)
+                              : param == WRITE_STROBE ? pass(n, delay, SAFE_GAP, SAFE_STROBE, SAFE_GAP)
+                                                      : pass(n, SAFE_STROBE, SAFE_GAP, delay, SAFE_GAP)))
+            n++;
+        if (n == passes)
+            return true;
+    }
+    return false;
+}
+
+int vdp_diag_timing(VdpTiming &timing)
+{
+    VDP_API(vdp_diag_timing);
+    shadowInvalidate();
+    setRegister(1, R1_16K); // Display off
+    bool ok = sweep(WRITE_STROBE, VDP_DIAG_PASSES, timing, timing.strobe_write) &&
+              sweep(READ_STROBE, VDP_DIAG_PASSES, timing, timing.strobe_read) &&
+              sweep(GAP, VDP_DIAG_PASSES, timing, timing.gap_blank);
+    setRegister(1, R1_16K | R1_DISPLAY);
+    ok = ok && sweep(GAP, ACTIVE_PASSES, timing, timing.gap_active);
+    setRegister(1, R1_16K);
+    return ok ? VDP_OK : VDP_ERROR;
+}
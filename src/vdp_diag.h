@@ -0,0 +1,70 @@
+/**
+ * @file vdp_diag.h
+ * @author Doctor Volt
+ * @brief Diagnostics of the VDP board: VRAM test and measurement of the bus timing
+ *
+ * Both overwrite VRAM and switch the display off. Call vdp_init() afterwards.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_DIAG_H
+#define VDP_DIAG_H
+#include "tms9918.h"
+
+/**
+ * @brief Passes of test data per step of vdp_diag_timing()
+ */
+#ifndef VDP_DIAG_PASSES
+#define VDP_DIAG_PASSES 8
+#endif
+
+/**
+ * @brief Where vdp_diag_march() failed
+ */
+struct VdpMarchResult
+{
+    uint16_t address; // First address that read back wrong
+    uint8_t expected;
+    uint8_t actual;   // expected ^ actual are the failing bits
+    uint8_t element;  // March element: 1 - 4 the read before a write, 5 the final read
+    uint8_t background; // Data background of the failing pass
+};
+
+/**
+ * @brief March C- test of all 16k. It finds stuck bits, transition faults, address decoder faults and coupling faults
+ * between cells. Each byte is tested against a data background and its inverse:
+ * up(w0); up(r0,w1); up(r1,w0); down(r0,w1); down(r1,w0); up(r0)
+ * Takes about 2 s per background on an Uno.
+ *
+ * @param result Where the test failed first, can be NULL
+ * @param backgrounds 1 - 4 of the backgrounds 0x00, 0x55, 0x33 and 0x0F. Background 0x00 alone finds all but the
+ * coupling faults between the bits of one byte, all 4 find these as well
+ * @returns VDP_OK | VDP_ERROR
+ */
+int vdp_diag_march(VdpMarchResult *result = NULL, uint8_t backgrounds = 4);
+
+/**
+ * @brief Fastest bus timing that still reads back correctly, see vdp_diag_timing().
+ * The delays are in loops of 3 CPU cycles, on top of the IO instructions of the access
+ */
+struct VdpTiming
+{
+    uint8_t strobe_write; // CSW low
+    uint8_t strobe_read;  // CSR low until the data is read
+    uint8_t gap_blank;    // Between two VRAM accesses with the display off
+    uint8_t gap_active;   // Between two VRAM accesses while the screen is drawn
+};
+
+/**
+ * @brief Measure the bus timing of the board: For each parameter the delay is swept upwards from 0 until a block of test
+ * data reads back correctly VDP_DIAG_PASSES times in a row, 32 times as many while the screen is drawn.
+ * The strobes are measured with safe gaps, the gaps with the strobes found.
+ * Compare the result with VDP_STROBE_CYCLES and the access windows of tms9918.cpp to see how much margin the fast bus
+ * paths have on this board.
+ *
+ * @returns VDP_ERROR if a parameter does not work even at the longest delay
+ */
+int vdp_diag_timing(VdpTiming &timing);
+
+#endif
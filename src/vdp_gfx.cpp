@@ -0,0 +1,238 @@
+/* Drawing functions of the Arduino library for TMS9918A, TMS9928 and TMS9929A Video Display Processors
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "vdp_gfx.h"
+
+// Pixels gathered for a byte of the pattern table
+struct
+{
+    uint8_t x, y; // Any pixel of the byte
+    uint8_t mask;
+    uint8_t color1, color2;
+} pen;
+
+void penBegin(uint8_t color1, uint8_t color2)
+{
+    pen.mask = 0;
+    pen.color1 = color1;
+    pen.color2 = color2;
+}
+
+void penFlush()
+{
+    if (pen.mask)
+        vdp_plot_hires_mask(pen.x, pen.y, pen.mask, pen.color1, pen.color2);
+    pen.mask = 0;
+}
+
+// Add pixels of the byte at (x,y). The gathered ones are written when the next pixel is in another byte
+void penMask(uint8_t x, uint8_t y, uint8_t mask)
+{
+    if (pen.mask && (pen.y != y || (pen.x ^ x) & 0xF8))
+        penFlush();
+    pen.x = x;
+    pen.y = y;
+    pen.mask |= mask;
+}
+
+void penPlot(int16_t x, int16_t y)
+{
+    if ((uint16_t)x < 256 && (uint16_t)y < 192)
+        penMask(x, y, 0x80 >> (x & 7));
+}
+
+// Pixels x0 to x1 of row y
+void penSpan(int16_t x0, int16_t x1, int16_t y)
+{
+    if ((uint16_t)y >= 192)
+        return;
+    if (x0 < 0)
+        x0 = 0;
+    if (x1 > 255)
+        x1 = 255;
+    while (x0 <= x1)
+    {
+        int16_t end = (x0 | 7) < x1 ? (x0 | 7) : x1; // Last pixel in the byte
+        penMask(x0, y, (0xFF >> (x0 & 7)) & (0xFF << (7 - (end & 7))));
+        x0 = end + 1;
+    }
+}
+
+void vdp_draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color1, uint8_t color2)
+{
+    VDP_API(vdp_draw_line);
+    penBegin(color1, color2);
+    // Bresenham
+    int16_t dx = x1 > x0 ? x1 - x0 : x0 - x1, sx = x0 < x1 ? 1 : -1;
+    int16_t dy = y1 > y0 ? y0 - y1 : y1 - y0, sy = y0 < y1 ? 1 : -1;
+    int16_t err = dx + dy;
+    while (true)
+    {
+        penPlot(x0, y0);
+        if (x0 == x1 && y0 == y1)
+            break;
+        int16_t e2 = 2 * err;
+        if (e2 >= dy)
+        {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx)
+        {
+            err += dx;
+            y0 += sy;
+        }
+    }
+    penFlush();
+}
+
+void vdp_draw_hline(int16_t x, int16_t y, int16_t w, uint8_t color1, uint8_t color2)
+{
+    VDP_API(vdp_draw_hline);
+    penBegin(color1, color2);
+    penSpan(x, x + w - 1, y);
+    penFlush();
+}
+
+void vdp_draw_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color1, uint8_t color2)
+{
+    VDP_API(vdp_draw_rect);
+    if (w <= 0 || h <= 0)
+        return;
+    penBegin(color1, color2);
+    int16_t x1 = x + w - 1, y1 = y + h - 1;
+    penSpan(x, x1, y);
+    for (int16_t row = y + 1 > 0 ? y + 1 : 0; row < y1 && row < 192; row++)
+    {
+        penPlot(x, row);
+        penPlot(x1, row); // Merged with the left side if in the same byte
+    }
+    if (h > 1)
+        penSpan(x, x1, y1);
+    penFlush();
+}
+
+void vdp_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color1, uint8_t color2)
+{
+    VDP_API(vdp_fill_rect);
+    penBegin(color1, color2);
+    for (int16_t row = y > 0 ? y : 0; row < y + h && row < 192; row++)
+        penSpan(x, x + w - 1, row);
+    penFlush();
+}
+
+// Largest x with x * x <= n
+int16_t isqrt(int32_t n)
+{
+    int32_t x = 0;
+    for (int16_t bit = 256; bit; bit >>= 1) // n is at most r * r + r
+        if ((x + bit) * (x + bit) <= n)
+            x += bit;
+    return x;
+}
+
+// Rows of a circle from top to bottom, so that the cells of a row stay in the line cache of the shadow VRAM.
+// The half width of row d is the largest x with x * x + d * d <= r * r + r
+void circle(int16_t cx, int16_t cy, uint8_t r, bool filled)
+{
+    int32_t rr = (int32_t)r * r + r;
+    int16_t first = cy - r > 0 ? cy - r : 0, last = cy + r < 191 ? cy + r : 191;
+    for (int16_t y = first; y <= last; y++)
+    {
+        int16_t d = y > cy ? y - cy : cy - y;
+        int16_t x = isqrt(rr - (int32_t)d * d);
+        int16_t inner = 0;
+        if (!filled && d < r) // The outline fills the gap to the next row away from the center
+        {
+            int16_t next = isqrt(rr - (int32_t)(d + 1) * (d + 1));
+            inner = next + 1 < x ? next + 1 : x;
+        }
+        if (inner == 0)
+            penSpan(cx - x, cx + x, y);
+        else
+        {
+            penSpan(cx - x, cx - inner, y);
+            penSpan(cx + inner, cx + x, y);
+        }
+    }
+}
+
+void vdp_draw_circle(int16_t cx, int16_t cy, uint8_t r, uint8_t color1, uint8_t color2)
+{
+    VDP_API(vdp_draw_circle);
+    penBegin(color1, color2);
+    circle(cx, cy, r, false);
+    penFlush();
+}
+
+void vdp_fill_circle(int16_t cx, int16_t cy, uint8_t r, uint8_t color1, uint8_t color2)
+{
+    VDP_API(vdp_fill_circle);
+    penBegin(color1, color2);
+    circle(cx, cy, r, true);
+    penFlush();
+}
+
+void vdp_fill_polygon(const int16_t *points, uint8_t n, uint8_t color1, uint8_t color2)
+{
+    VDP_API(vdp_fill_polygon);
+    if (n < 3 || n > VDP_GFX_POLYGON)
+        return;
+    int16_t top = points[1], bottom = points[1];
+    for (uint8_t i = 1; i < n; i++)
+    {
+        if (points[2 * i + 1] < top)
+            top = points[2 * i + 1];
+        if (points[2 * i + 1] > bottom)
+            bottom = points[2 * i + 1];
+    }
+    if (top < 0)
+        top = 0;
+    if (bottom > 192)
+        bottom = 192;
+    penBegin(color1, color2);
+    int16_t cross[VDP_GFX_POLYGON]; // First pixel right of each edge
+    for (int16_t y = top; y < bottom; y++)
+    {
+        uint8_t m = 0;
+        for (uint8_t i = 0; i < n; i++)
+        {
+            const int16_t *a = points + 2 * i, *b = points + 2 * ((i + 1) % n);
+            if (a[1] > b[1])
+            {
+                const int16_t *t = a;
+                a = b;
+                b = t;
+            }
+            if (y < a[1] || y >= b[1]) // Also skips horizontal edges
+                continue;
+            // The edge crosses the center of the row at a[0] + num / den. The first pixel whose center is not left of it
+            // is a[0] + ceil((num - den / 2) / den)
+            int32_t num = (int32_t)(2 * (y - a[1]) + 1) * (b[0] - a[0]) - (b[1] - a[1]);
+            int32_t den = 2 * (b[1] - a[1]);
+            int16_t x = a[0] + (num >= 0 ? (num + den - 1) / den : -(-num / den));
+            uint8_t j = m++;
+            for (; j > 0 && cross[j - 1] > x; j--) // Insertion sort
+                cross[j] = cross[j - 1];
+            cross[j] = x;
+        }
+        for (uint8_t i = 0; i + 1 < m; i += 2)
+            penSpan(cross[i], cross[i + 1] - 1, y);
+    }
+    penFlush();
+}
@@ -0,0 +1,64 @@
+/**
+ * @file vdp_gfx.h
+ * @author Doctor Volt
+ * @brief Lines, rectangles, circles and polygons in the 256x192 resolution of Graphics Mode 2
+ *
+ * The pixels are gathered per byte of the pattern table, 8 neighboring pixels of a row, and each byte is written with one
+ * read-modify-write by vdp_plot_hires_mask(). Horizontal spans write whole bytes. The colors work as in vdp_plot_hires():
+ * color1 != 0 sets the pixels and the foreground color of their bytes, color1 == 0 clears them and sets the background color2.
+ * Coordinates may be outside the screen, the pixels there are clipped.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_GFX_H
+#define VDP_GFX_H
+#include "tms9918.h"
+
+/**
+ * @brief Maximum number of corners of vdp_fill_polygon()
+ */
+#ifndef VDP_GFX_POLYGON
+#define VDP_GFX_POLYGON 16
+#endif
+
+/**
+ * @brief Line from (x0,y0) to (x1,y1), both ends included
+ */
+void vdp_draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t color1, uint8_t color2 = 0);
+
+/**
+ * @brief Horizontal line of w pixels starting at (x,y)
+ */
+void vdp_draw_hline(int16_t x, int16_t y, int16_t w, uint8_t color1, uint8_t color2 = 0);
+
+/**
+ * @brief Outline of a rectangle of w by h pixels with the top left corner at (x,y)
+ */
+void vdp_draw_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color1, uint8_t color2 = 0);
+
+/**
+ * @brief Filled rectangle of w by h pixels with the top left corner at (x,y)
+ */
+void vdp_fill_rect(int16_t x, int16_t y, int16_t w, int16_t h, uint8_t color1, uint8_t color2 = 0);
+
+/**
+ * @brief Outline of a circle around (cx,cy)
+ */
+void vdp_draw_circle(int16_t cx, int16_t cy, uint8_t r, uint8_t color1, uint8_t color2 = 0);
+
+/**
+ * @brief Filled circle around (cx,cy)
+ */
+void vdp_fill_circle(int16_t cx, int16_t cy, uint8_t r, uint8_t color1, uint8_t color2 = 0);
+
+/**
+ * @brief Filled polygon. A pixel is inside if its center is, with the even-odd rule for crossing edges.
+ * Polygons that share an edge do not overlap
+ *
+ * @param points x and y of each corner: x0, y0, x1, y1, ... from -2048 to 2047
+ * @param n Number of corners, 3 to VDP_GFX_POLYGON
+ */
+void vdp_fill_polygon(const int16_t *points, uint8_t n, uint8_t color1, uint8_t color2 = 0);
+
+#endif
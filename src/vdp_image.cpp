@@ -0,0 +1,271 @@
+/* Image loader of the Arduino library for TMS9918A, TMS9928 and TMS9929A Video Display Processors
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+#include "vdp_image.h"
+
+VdpG2Loader::VdpG2Loader(uint8_t first_row)
+{
+    y = first_row & ~7;
+    band_rows = 0;
+}
+
+void VdpG2Loader::write_row(const uint8_t *pixels, uint8_t color_offset)
+{
+    VDP_API(g2_loader_write_row);
+    if (y >= 192)
+        return;
+    uint8_t line = y & 7;
+    for (uint8_t cell = 0; cell < 32; cell++, pixels += 8)
+        tms_image_cell(pixels, color_offset, patterns[cell * 8 + line], colors[cell * 8 + line]);
+    band_rows++;
+    y++;
+    if (line == 7)
+        finish();
+}
+
+void VdpG2Loader::finish()
+{
+    VDP_API(g2_loader_finish);
+    if (!band_rows)
+        return;
+    uint16_t offset = (uint16_t)((y - 1) & ~7) << 5; // 256 bytes per band
+    if (band_rows == 8)
+    {
+        vdp_write_block(vdp_pattern_table() + offset, patterns, 256);
+        vdp_write_block(vdp_color_table() + offset, colors, 256);
+    }
+    else // Only the converted lines of every cell
+    {
+        uint8_t first = (y - band_rows) & 7;
+        for (uint8_t cell = 0; cell < 32; cell++)
+        {
+            uint16_t i = cell * 8 + first;
+            vdp_write_block(vdp_pattern_table() + offset + i, patterns + i, band_rows);
+            vdp_write_block(vdp_color_table() + offset + i, colors + i, band_rows);
+        }
+    }
+    band_rows = 0;
+}
+
+void vdp_load_g2_bitmap(bool (*read_row)(uint8_t *row, uint8_t y), uint8_t color_offset)
+{
+    VDP_API(vdp_load_g2_bitmap);
+    VdpG2Loader loader;
+    uint8_t row[256];
+    while (loader.row() < 192)
+    {
+        if (!read_row(row, loader.row()))
+            break;
+        loader.write_row(row, color_offset);
+    }
+    loader.finish();
+}
+
+void VdpStreamPlayer::begin()
+{
+    VDP_API(stream_player_begin);
+    state = FRAME;
+    head_len = 0;
+    frame_count = 0;
+    n_runs = 0;
+    staged = 0;
+}
+
+// Writes the staged runs, called by vdp_service() in the vertical blank
+void VdpStreamPlayer::flushJob(void *arg)
+{
+    VdpStreamPlayer *p = (VdpStreamPlayer *)arg;
+    const uint8_t *src = p->stage;
+    for (uint8_t i = 0; i < p->n_runs; i++)
+    {
+        vdp_write_block(p->runs[i].addr, src, p->runs[i].len);
+        src += p->runs[i].len;
+    }
+    p->n_runs = 0;
+    p->staged = 0;
+    p->pending = false;
+}
+
+void VdpStreamPlayer::flush()
+{
+    if (!staged)
+        return;
+    pending = true;
+    while (!vdp_queue(flushJob, this, staged + 2 * n_runs))
+        vdp_service();
+    while (pending)
+        vdp_service();
+}
+
+void VdpStreamPlayer::endFrame()
+{
+    flush();
+    frame_count++;
+    state = FRAME;
+}
+
+void VdpStreamPlayer::endRecord()
+{
+    if (--records)
+        state = RECORD;
+    else
+        endFrame();
+}
+
+// Collects the header of a frame or a record
+void VdpStreamPlayer::header(uint8_t b)
+{
+    head[head_len++] = b;
+    if (head_len < 3)
+        return;
+    head_len = 0;
+    if (state == FRAME)
+    {
+        records = head[1] | (head[2] << 8);
+        if (head[0] & TMS_STREAM_END)
+        {
+            flush();
+            state = END;
+        }
+        else if (!records)
+            endFrame();
+        else
+            state = RECORD;
+        return;
+    }
+    uint16_t cell = head[0] | (head[1] << 8);
+    addr = cell < TMS_STREAM_CELLS / 2 ? vdp_pattern_table() + cell * 8 : vdp_color_table() + (cell - TMS_STREAM_CELLS / 2) * 8;
+    left = head[2] * 8;
+    state = DATA;
+    if (!left) // Record without data, nothing to write
+        endRecord();
+}
+
+bool VdpStreamPlayer::write(const uint8_t *data, uint16_t len)
+{
+    VDP_API(stream_player_write);
+    while (len && state != END)
+    {
+        if (state != DATA)
+        {
+            header(*data++);
+            len--;
+            continue;
+        }
+        // Extend the last run or start a new one
+        uint16_t k = VDP_STREAM_STAGE - staged;
+        if (k > len)
+            k = len;
+        if (k > left)
+            k = left;
+        Run *run = n_runs ? &runs[n_runs - 1] : NULL;
+        if (!run || run->addr + run->len != addr || run->len + k > 255)
+        {
+            if (n_runs == VDP_STREAM_RUNS)
+            {
+                flush();
+                continue;
+            }
+            run = &runs[n_runs++];
+            run->addr = addr;
+            run->len = 0;
+        }
+        memcpy(stage + staged, data, k);
+        staged += k;
+        run->len += k;
+        addr += k;
+        data += k;
+        len -= k;
+        left -= k;
+        if (staged == VDP_STREAM_STAGE)
+            flush();
+        if (!left)
+            endRecord();
+    }
+    return state != END;
+}
+
+bool VdpTmsLoader::begin(const uint8_t *header)
+{
+    pos = 0;
+    rle = TmsRle();
+    buffered = 0;
+    return tms_image_check(header, flags, size);
+}
+
+// Write n bytes of src, or n times value if src is NULL, at the current position of the image
+void VdpTmsLoader::put(const uint8_t *src, uint8_t value, uint16_t n)
+{
+    while (n && pos < TMS_IMAGE_SIZE)
+    {
+        uint16_t addr, left; // Bytes left in the current table
+        if (pos < TMS_IMAGE_TABLE_SIZE)
+        {
+            addr = vdp_pattern_table() + pos;
+            left = TMS_IMAGE_TABLE_SIZE - pos;
+        }
+        else
+        {
+            addr = vdp_color_table() + pos - TMS_IMAGE_TABLE_SIZE;
+            left = TMS_IMAGE_SIZE - pos;
+        }
+        uint16_t k = n < left ? n : left;
+        if (src)
+        {
+            vdp_write_block(addr, src, k);
+            src += k;
+        }
+        else
+            vdp_fill(addr, value, k);
+        pos += k;
+        n -= k;
+    }
+}
+
+void VdpTmsLoader::flushLiterals()
+{
+    put(buffer, 0, buffered);
+    buffered = 0;
+}
+
+void VdpTmsLoader::write(const uint8_t *data, uint16_t len)
+{
+    VDP_API(tms_loader_write);
+    if (!(flags & TMS_IMAGE_RLE))
+    {
+        put(data, 0, len);
+        return;
+    }
+    while (len--)
+    {
+        uint8_t value;
+        uint8_t n = tms_rle_decode(rle, *data++, value);
+        if (n == 1)
+        {
+            buffer[buffered++] = value;
+            if (buffered == sizeof(buffer))
+                flushLiterals();
+        }
+        else if (n > 1)
+        {
+            flushLiterals();
+            put(NULL, value, n);
+        }
+    }
+    if (!rle.literals) // End of a literal block
+        flushLiterals();
+}
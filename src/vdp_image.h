@@ -0,0 +1,162 @@
+/**
+ * @file vdp_image.h
+ * @author Doctor Volt
+ * @brief Loading 256x192 images and streams of frames into Graphics Mode 2
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_IMAGE_H
+#define VDP_IMAGE_H
+#include "tms9918.h"
+#include "tmsimage.h"
+
+/**
+ * @brief Bytes of changed cells VdpStreamPlayer collects in RAM, up to 255. About what arrives at 115200 baud within a frame
+ */
+#ifndef VDP_STREAM_STAGE
+#define VDP_STREAM_STAGE 192
+#endif
+#define VDP_STREAM_RUNS 8
+
+/**
+ * @brief Row sink for 256x192 images in Graphics Mode 2.
+ * Rows of 256 colors are converted to patterns and colors in RAM. After every 8 rows the band is written to
+ * the pattern and the color table with one burst each.
+ * Only two colors are possible within 8 neighboring pixels. The most frequent color of 8 pixels becomes the
+ * foreground, the second most frequent the background. Pixels of other colors get the background color.
+ */
+class VdpG2Loader
+{
+public:
+    /**
+     * @param first_row First row to write 0-191, rounded down to a multiple of 8
+     */
+    VdpG2Loader(uint8_t first_row = 0);
+
+    /**
+     * @brief Convert the next row
+     *
+     * @param pixels 256 colors
+     * @param color_offset Added to every color, e.g. 1 for palette indices of the tms9918.gpl Gimp palette
+     */
+    void write_row(const uint8_t *pixels, uint8_t color_offset = 0);
+
+    /**
+     * @brief Write the rows of an incomplete band
+     */
+    void finish();
+
+    /**
+     * @brief Number of the next row
+     */
+    uint8_t row() const { return y; }
+
+private:
+    uint8_t patterns[256];
+    uint8_t colors[256];
+    uint8_t y;
+    uint8_t band_rows; // Rows converted into the band buffer
+};
+
+/**
+ * @brief Load a 256x192 image into Graphics Mode 2 with a VdpG2Loader
+ *
+ * @param read_row Called for every row y = 0..191 to fill row with 256 colors. Returns false to abort
+ * @param color_offset Added to every color, e.g. 1 for palette indices of the tms9918.gpl Gimp palette
+ */
+void vdp_load_g2_bitmap(bool (*read_row)(uint8_t *row, uint8_t y), uint8_t color_offset = 0);
+
+/**
+ * @brief Copies a TMS image (see tmsimage.h) into VRAM as it arrives. Call vdp_init_g2() first.
+ * Uncompressed data and literal blocks are written with vdp_write_block(), runs with vdp_fill().
+ */
+class VdpTmsLoader
+{
+public:
+    /**
+     * @brief Start a new image
+     *
+     * @param header TMS_IMAGE_HEADER_SIZE bytes
+     * @returns false if header is not the header of a TMS image
+     */
+    bool begin(const uint8_t *header);
+
+    /**
+     * @brief Feed the next bytes of the image data
+     */
+    void write(const uint8_t *data, uint16_t len);
+
+    /**
+     * @brief Size of the image data in bytes, as given by the header
+     */
+    uint16_t data_size() const { return size; }
+
+private:
+    uint8_t flags;
+    uint16_t size;
+    uint16_t pos; // Position in the decoded image
+    TmsRle rle;
+    uint8_t buffer[32]; // Literal bytes
+    uint8_t buffered;
+    void put(const uint8_t *src, uint8_t value, uint16_t n);
+    void flushLiterals();
+};
+
+/**
+ * @brief Plays a stream of frames (see tmsimage.h) as it arrives. Call vdp_init_g2() first.
+ * The changed cells are collected in RAM and written in the vertical blank with vdp_queue() and vdp_service(),
+ * adjacent cells in one burst. A frame is completed before the next one starts, so the frame rate follows the
+ * amount of changed cells. Jobs already queued by the sketch run first.
+ */
+class VdpStreamPlayer
+{
+public:
+    /**
+     * @brief Start a new stream, after its header
+     */
+    void begin();
+
+    /**
+     * @brief Feed the next bytes of the stream
+     * @returns false after the end of the stream
+     */
+    bool write(const uint8_t *data, uint16_t len);
+
+    /**
+     * @brief Number of frames shown
+     */
+    uint16_t frames() const { return frame_count; }
+
+private:
+    enum State : uint8_t
+    {
+        FRAME,
+        RECORD,
+        DATA,
+        END
+    };
+    State state;
+    uint8_t head[3]; // Header of a frame or record
+    uint8_t head_len;
+    uint16_t records; // Records left in the frame
+    uint16_t addr;    // VRAM address of the next byte
+    uint16_t left;    // Bytes left in the record
+    uint16_t frame_count;
+    struct Run
+    {
+        uint16_t addr;
+        uint8_t len;
+    } runs[VDP_STREAM_RUNS];
+    uint8_t n_runs;
+    uint8_t stage[VDP_STREAM_STAGE];
+    uint8_t staged;
+    volatile bool pending;
+    void header(uint8_t b);
+    void endFrame();
+    void endRecord();
+    void flush();
+    static void flushJob(void *arg);
+};
+
+#endif
@@ -0,0 +1,119 @@
+/* Instrumentation of the Arduino library for TMS9918A, TMS9928 and TMS9929A Video Display Processors
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "vdp_instrument.h"
+#ifdef VDP_INSTRUMENT
+
+// Names of the tagged functions, one after the other, each terminated by 0
+static const char api_names[] PROGMEM =
+    "(other)\0"
+#define VDP_INSTRUMENT_NAME(id, name) name "\0"
+    VDP_INSTRUMENT_APIS(VDP_INSTRUMENT_NAME)
+#undef VDP_INSTRUMENT_NAME
+    ;
+
+static VdpCounters slots[VDP_INSTRUMENT_SLOTS]; // Slot 0 counts (other)
+static uint8_t slot_api[VDP_INSTRUMENT_SLOTS];  // Function of each slot, VDP_API_OTHER: free
+static uint32_t start;
+
+uint8_t vdp_instrument_api = VDP_API_OTHER;
+VdpCounters *vdp_instrument_counters = slots;
+
+static VdpCounters *slot(uint8_t api, bool alloc)
+{
+    for (uint8_t i = 1; i < VDP_INSTRUMENT_SLOTS; i++)
+    {
+        if (slot_api[i] == api)
+            return &slots[i];
+        if (slot_api[i] == VDP_API_OTHER)
+        {
+            if (!alloc)
+                return NULL;
+            slot_api[i] = api;
+            return &slots[i];
+        }
+    }
+    return alloc ? slots : NULL; // All slots taken
+}
+
+void vdp_instrument_begin(uint8_t api)
+{
+    vdp_instrument_api = api;
+    vdp_instrument_counters = slot(api, true);
+    vdp_instrument_counters->calls++;
+    start = micros();
+}
+
+void vdp_instrument_end()
+{
+    vdp_instrument_counters->micros += micros() - start;
+    vdp_instrument_api = VDP_API_OTHER;
+    vdp_instrument_counters = slots;
+}
+
+void vdp_instrument_reset()
+{
+    memset(slots, 0, sizeof(slots));
+    memset(slot_api, VDP_API_OTHER, sizeof(slot_api));
+    if (vdp_instrument_api != VDP_API_OTHER) // Called inside a tagged function, e.g. a job of vdp_service()
+        vdp_instrument_begin(vdp_instrument_api);
+}
+
+const VdpCounters *vdp_instrument_get(VdpApi api)
+{
+    return api == VDP_API_OTHER ? slots : slot(api, false);
+}
+
+// Right aligned number in a column of width characters
+static void printColumn(Print &out, uint32_t value, uint8_t width)
+{
+    uint8_t digits = 1;
+    for (uint32_t v = value; v >= 10; v /= 10)
+        digits++;
+    while (width-- > digits)
+        out.print(' ');
+    out.print(value);
+}
+
+static void printRow(Print &out, uint8_t api, const VdpCounters &c)
+{
+    PGM_P name = api_names;
+    while (api--)
+        name += strlen_P(name) + 1;
+    out.print((const __FlashStringHelper *)name);
+    for (uint8_t n = strlen_P(name); n < 24; n++)
+        out.print(' ');
+    printColumn(out, c.calls, 8);
+    printColumn(out, c.address_setups, 8);
+    printColumn(out, c.bytes_written, 9);
+    printColumn(out, c.bytes_read, 9);
+    printColumn(out, c.register_writes, 6);
+    printColumn(out, c.status_reads, 7);
+    printColumn(out, c.micros, 11);
+    out.println();
+}
+
+void vdp_instrument_dump(Print &out)
+{
+    out.println(F("function                   calls   setup  written     read  regs status     micros"));
+    for (uint8_t i = 1; i < VDP_INSTRUMENT_SLOTS && slot_api[i] != VDP_API_OTHER; i++)
+        printRow(out, slot_api[i], slots[i]);
+    printRow(out, VDP_API_OTHER, slots[0]);
+}
+
+#endif
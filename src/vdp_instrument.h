@@ -0,0 +1,162 @@
+/**
+ * @file vdp_instrument.h
+ * @author Doctor Volt
+ * @brief Counters of the bus traffic per API function, to find the expensive calls of a sketch
+ *
+ * Compiled in with VDP_INSTRUMENT defined, for the library and the sketch: Uncomment it below or pass -DVDP_INSTRUMENT.
+ * Without it the counting compiles to nothing.
+ *
+ * Every public function of the library is tagged with VDP_API(). Address setups, VRAM bytes, register writes,
+ * status reads and the time spent are counted for the outermost tagged function of a call, e.g. the vdp_fill() inside
+ * vdp_print() counts for vdp_print(). Traffic outside of tagged functions counts as (other).
+ * The counters of up to VDP_INSTRUMENT_SLOTS functions are kept, further functions count as (other) as well.
+ * Jobs of vdp_queue() run in vdp_service() from the main loop, the interrupt of vdp_vblank_service() only flags the frame.
+ * They count for vdp_service(), or for the function that called it, e.g. VdpConsole::flush() when the queue is full.
+ *
+ * vdp_instrument_reset();
+ * ... code to measure
+ * vdp_instrument_dump(Serial);
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_INSTRUMENT_H
+#define VDP_INSTRUMENT_H
+#include "Arduino.h"
+
+// #define VDP_INSTRUMENT
+
+#ifndef VDP_INSTRUMENT_SLOTS
+#define VDP_INSTRUMENT_SLOTS 12 // 29 bytes of RAM each
+#endif
+
+// Tagged functions: Identifier and name in the dump
+#define VDP_INSTRUMENT_APIS(X)                                  \
+    X(vdp_init, "vdp_init")                                     \
+    X(vdp_set_mode, "vdp_set_mode")                             \
+    X(vdp_write_block, "vdp_write_block")                       \
+    X(vdp_write_block_P, "vdp_write_block_P")                   \
+    X(vdp_read_block, "vdp_read_block")                         \
+    X(vdp_fill, "vdp_fill")                                     \
+    X(vdp_write, "vdp_write")                                   \
+    X(vdp_colorize, "vdp_colorize")                             \
+    X(vdp_print, "vdp_print")                                   \
+    X(vdp_printf, "vdp_printf")                                 \
+    X(vdp_text, "vdp_text")                                     \
+    X(vdp_textcolor, "vdp_textcolor")                           \
+    X(vdp_set_bdcolor, "vdp_set_bdcolor")                       \
+    X(vdp_set_pattern_color, "vdp_set_pattern_color")           \
+    X(vdp_plot_hires, "vdp_plot_hires")                         \
+    X(vdp_plot_hires_mask, "vdp_plot_hires_mask")               \
+    X(vdp_plot_color, "vdp_plot_color")                         \
+    X(vdp_set_sprite_pattern, "vdp_set_sprite_pattern")         \
+    X(vdp_sprite_init, "vdp_sprite_init")                       \
+    X(vdp_sprite_set_position, "vdp_sprite_set_position")       \
+    X(vdp_sprite_get_attributes, "vdp_sprite_get_attributes")   \
+    X(vdp_sprite_get_position, "vdp_sprite_get_position")       \
+    X(vdp_sprite_color, "vdp_sprite_color")                     \
+    X(vdp_sprite_write_table, "vdp_sprite_write_table")         \
+    X(sprite_table_commit, "VdpSpriteTable::commit")            \
+    X(sprite_mux_commit, "VdpSpriteMux::commit")                \
+    X(vdp_double_buffer, "vdp_double_buffer")                   \
+    X(vdp_flush, "vdp_flush")                                   \
+    X(vdp_service, "vdp_service")                               \
+    X(vdp_vblank_service, "vdp_vblank_service")                 \
+    X(vdp_tile_cache, "vdp_tile_cache")                         \
+    X(vdp_draw_line, "vdp_draw_line")                           \
+    X(vdp_draw_hline, "vdp_draw_hline")                         \
+    X(vdp_draw_rect, "vdp_draw_rect")                           \
+    X(vdp_fill_rect, "vdp_fill_rect")                           \
+    X(vdp_draw_circle, "vdp_draw_circle")                       \
+    X(vdp_fill_circle, "vdp_fill_circle")                       \
+    X(vdp_fill_polygon, "vdp_fill_polygon")                     \
+    X(console_begin, "VdpConsole::begin")                       \
+    X(console_write, "VdpConsole::write")                       \
+    X(console_clear, "VdpConsole::clear")                       \
+    X(console_flush, "VdpConsole::flush")                       \
+    X(lowres_blit, "VdpLowres::blit")                           \
+    X(vdp_load_g2_bitmap, "vdp_load_g2_bitmap")                 \
+    X(g2_loader_write_row, "VdpG2Loader::write_row")            \
+    X(g2_loader_finish, "VdpG2Loader::finish")                  \
+    X(tms_loader_write, "VdpTmsLoader::write")                  \
+    X(stream_player_begin, "VdpStreamPlayer::begin")            \
+    X(stream_player_write, "VdpStreamPlayer::write")            \
+    X(vdp_diag_march, "vdp_diag_march")                         \
+    X(vdp_diag_timing, "vdp_diag_timing")
+
+enum VdpApi
+{
+    VDP_API_OTHER,
+#define VDP_INSTRUMENT_ENUM(id, name) VDP_API_##id,
+    VDP_INSTRUMENT_APIS(VDP_INSTRUMENT_ENUM)
+#undef VDP_INSTRUMENT_ENUM
+    VDP_API_COUNT
+};
+
+/**
+ * @brief Bus traffic of a function
+ */
+struct VdpCounters
+{
+    uint32_t calls;
+    uint32_t address_setups;
+    uint32_t bytes_written;   // VRAM bytes
+    uint32_t bytes_read;
+    uint32_t register_writes;
+    uint32_t status_reads;
+    uint32_t micros;          // Time spent in the function
+};
+
+#ifdef VDP_INSTRUMENT
+extern uint8_t vdp_instrument_api;          // Function being counted, VDP_API_OTHER outside of tagged functions
+extern VdpCounters *vdp_instrument_counters; // Its counters
+void vdp_instrument_begin(uint8_t api);
+void vdp_instrument_end();
+
+// Counts a tagged function while it runs, unless it is called by another one
+class VdpApiScope
+{
+public:
+    VdpApiScope(uint8_t api) : outer(vdp_instrument_api == VDP_API_OTHER)
+    {
+        if (outer)
+            vdp_instrument_begin(api);
+    }
+    ~VdpApiScope()
+    {
+        if (outer)
+            vdp_instrument_end();
+    }
+
+private:
+    bool outer;
+};
+
+#define VDP_API(id) VdpApiScope vdp_api_scope(VDP_API_##id)
+#define VDP_COUNT(counter) vdp_instrument_counters->counter++
+
+/**
+ * @brief Clear all counters
+ */
+void vdp_instrument_reset();
+
+/**
+ * @brief Counters of a function
+ * @returns NULL if it was not called since vdp_instrument_reset() or got no slot
+ */
+const VdpCounters *vdp_instrument_get(VdpApi api);
+
+/**
+ * @brief Print a table of the counters, one row per function. In the simulator Serial writes to stdout
+ */
+void vdp_instrument_dump(Print &out = Serial);
+
+#else
+#define VDP_API(id)
+#define VDP_COUNT(counter)
+inline void vdp_instrument_reset() {}
+inline const VdpCounters *vdp_instrument_get(VdpApi) { return NULL; }
+inline void vdp_instrument_dump(Print & = Serial) {}
+#endif
+
+#endif
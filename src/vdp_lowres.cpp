@@ -0,0 +1,101 @@
+/* Low resolution framebuffers of the Arduino library for TMS9918A, TMS9928 and TMS9929A Video Display Processors
+    Copyright (C) 2022  Doctor Volt
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+*/
+
+
+#include "vdp_lowres.h"
+
+void VdpLowres::plot(uint8_t x, uint8_t y, uint8_t color)
+{
+    uint8_t row = y - y0;
+    if (x >= VDP_LOWRES_WIDTH || y < y0 || row >= bands * 8)
+        return;
+    uint8_t *p = data + (row >> 3) * VDP_LOWRES_BAND + (x >> 1) * 8 + (row & 7);
+    if (x & 1)
+        *p = (*p & 0xF0) | (color & 0x0F);
+    else
+        *p = (*p & 0x0F) | (color << 4);
+}
+
+uint8_t VdpLowres::get(uint8_t x, uint8_t y) const
+{
+    uint8_t row = y - y0;
+    if (x >= VDP_LOWRES_WIDTH || y < y0 || row >= bands * 8)
+        return VDP_TRANSPARENT;
+    uint8_t byte = data[(row >> 3) * VDP_LOWRES_BAND + (x >> 1) * 8 + (row & 7)];
+    return x & 1 ? byte & 0x0F : byte >> 4;
+}
+
+void VdpLowres::fill_rect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color)
+{
+    // Clip to the buffer, in rows of the buffer
+    uint16_t x1 = x + w < VDP_LOWRES_WIDTH ? x + w : VDP_LOWRES_WIDTH;
+    int16_t first = y - y0, last = y + h - y0;
+    if (first < 0)
+        first = 0;
+    if (last > bands * 8)
+        last = bands * 8;
+    if (x >= x1 || first >= last)
+        return;
+    uint8_t value = (color & 0x0F) * 0x11;
+    for (uint8_t pair = x >> 1; pair <= (x1 - 1) >> 1; pair++)
+    {
+        uint8_t mask = 0xFF; // Nibbles inside the rectangle
+        if (pair * 2 < x)
+            mask = 0x0F;
+        if (pair * 2 + 1 >= x1)
+            mask &= 0xF0;
+        // The rows of a band are consecutive bytes
+        for (uint8_t row = first; row < last;)
+        {
+            uint8_t *p = data + (row >> 3) * VDP_LOWRES_BAND + pair * 8 + (row & 7);
+            uint8_t n = 8 - (row & 7);
+            if (n > last - row)
+                n = last - row;
+            if (mask == 0xFF)
+                memset(p, value, n);
+            else
+                for (uint8_t i = 0; i < n; i++)
+                    p[i] = (p[i] & ~mask) | (value & mask);
+            row += n;
+        }
+    }
+}
+
+// Writes the buffer, called by vdp_service() in the vertical blank
+void VdpLowres::blitJob(void *arg)
+{
+    VdpLowres *fb = (VdpLowres *)arg;
+    vdp_write_block(fb->blit_addr, fb->data, fb->blit_len);
+    fb->pending = false;
+}
+
+void VdpLowres::blitTo(uint16_t addr, uint16_t len, bool wait_vblank)
+{
+    VDP_API(lowres_blit);
+    blit_addr = addr;
+    blit_len = len;
+    if (!wait_vblank)
+    {
+        blitJob(this);
+        return;
+    }
+    pending = true;
+    while (!vdp_queue(blitJob, this, len))
+        vdp_service();
+    while (pending)
+        vdp_service();
+}
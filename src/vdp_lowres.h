@@ -0,0 +1,114 @@
+/**
+ * @file vdp_lowres.h
+ * @author Doctor Volt
+ * @brief Framebuffers in RAM for 64x48 Multicolor mode and 64x192 low resolution in Graphics Mode 2
+ *
+ * Two pixels are packed into a byte, the left one in the high nibble. The bytes are in the order of VRAM:
+ * A band of 8 pixel rows takes 256 bytes, 8 bytes for each pair of columns, one per row. blit() copies the buffer in one burst.
+ * In Multicolor mode the bytes go to the pattern table, in Graphics Mode 2 to the color table, with all patterns set to 0xF0.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_LOWRES_H
+#define VDP_LOWRES_H
+#include "tms9918.h"
+
+#define VDP_LOWRES_WIDTH 64
+#define VDP_LOWRES_BAND 256 // Bytes of 8 pixel rows
+
+/**
+ * @brief Drawing functions of the framebuffers. Coordinates are those of the screen, pixels outside the buffer are clipped
+ */
+class VdpLowres
+{
+public:
+    void plot(uint8_t x, uint8_t y, uint8_t color);
+    uint8_t get(uint8_t x, uint8_t y) const;
+
+    /**
+     * @brief Fill a rectangle. Pairs of pixels are written as whole bytes
+     */
+    void fill_rect(uint8_t x, uint8_t y, uint8_t w, uint8_t h, uint8_t color);
+    void hline(uint8_t x, uint8_t y, uint8_t w, uint8_t color) { fill_rect(x, y, w, 1, color); }
+    void vline(uint8_t x, uint8_t y, uint8_t h, uint8_t color) { fill_rect(x, y, 1, h, color); }
+    void fill(uint8_t color) { memset(data, color * 0x11, bands * VDP_LOWRES_BAND); }
+
+    /**
+     * @brief First and number of pixel rows in the buffer
+     */
+    uint8_t top() const { return y0; }
+    uint8_t height() const { return bands * 8; }
+
+protected:
+    VdpLowres(uint8_t *data, uint8_t bands) : data(data), bands(bands), y0(0) {}
+    void blitTo(uint16_t addr, uint16_t len, bool wait_vblank);
+
+    uint8_t *data;
+    uint8_t bands;
+    uint8_t y0;
+
+private:
+    uint16_t blit_addr, blit_len;
+    volatile bool pending;
+    static void blitJob(void *arg);
+};
+
+/**
+ * @brief Full screen of Multicolor mode, 64x48 pixels in 1536 bytes. Call vdp_init_multicolor() first
+ */
+class VdpMulticolorFrame : public VdpLowres
+{
+public:
+    VdpMulticolorFrame() : VdpLowres(buffer, 6) {}
+
+    /**
+     * @brief Copy the buffer to the pattern table
+     *
+     * @param wait_vblank Write in the vertical blank through vdp_queue(), where the screen does not tear
+     */
+    void blit(bool wait_vblank = false) { blitTo(vdp_pattern_table(), sizeof(buffer), wait_vblank); }
+
+private:
+    uint8_t buffer[6 * VDP_LOWRES_BAND];
+};
+
+/**
+ * @brief Band of ROWS * 8 pixel rows of the 64x192 low resolution screen of Graphics Mode 2. The full screen needs 6k,
+ * more than an Uno has, so it is drawn band by band:
+ * for (uint8_t y = 0; y < 192; y += band.height()) { band.select(y); draw everything; band.blit(); }
+ *
+ * @tparam ROWS 1 - 24 rows of 8 pixels, 256 bytes each
+ */
+template <uint8_t ROWS = 2>
+class VdpG2Lowres : public VdpLowres
+{
+public:
+    VdpG2Lowres() : VdpLowres(buffer, ROWS) {}
+
+    /**
+     * @brief Set all patterns to 0xF0, so each byte of the color table shows two pixels. Call vdp_init_g2() first
+     */
+    void begin() { vdp_fill(vdp_pattern_table(), 0xF0, 0x1800); }
+
+    /**
+     * @brief Move the buffer to another part of the screen. The content stays
+     *
+     * @param y First pixel row, rounded down to a multiple of 8, below 192
+     */
+    void select(uint8_t y) { y0 = y < 192 ? y & ~7 : 184; }
+
+    /**
+     * @brief Copy the buffer to its part of the color table. Rows below the screen are left out
+     */
+    void blit(bool wait_vblank = false)
+    {
+        uint8_t rows = (192 - y0) / 8 < ROWS ? (192 - y0) / 8 : ROWS;
+        blitTo(vdp_color_table() + y0 * (VDP_LOWRES_BAND / 8), rows * VDP_LOWRES_BAND, wait_vblank);
+    }
+
+private:
+    uint8_t buffer[ROWS * VDP_LOWRES_BAND];
+};
+
+#endif
@@ -0,0 +1,129 @@
+/**
+ * @file vdp_mode.h
+ * @author Doctor Volt
+ * @brief The driver specialised at compile time on one screen mode
+ *
+ * Vdp<SCREEN_MODE> holds the table addresses vdp_init() sets up for the mode, the size of the screen and what the mode
+ * supports as constants. Code written for one mode calls it directly: The address arithmetic folds into constants and the
+ * branches of the other modes are left out by the compiler. The functions of tms9918.h check the mode once and call the
+ * matching Vdp<>, so both share the same code.
+ *
+ * Vdp<VDP_MODE_G1>::init(VDP_WHITE, VDP_BLACK);
+ * Vdp<VDP_MODE_G1>::write(0, 0, 'A');
+ *
+ * The control lines are resolved at compile time by vdp_pins.h already, for every mode.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_MODE_H
+#define VDP_MODE_H
+#include "tms9918.h"
+
+// VRAM access of tms9918.cpp, through the shadow while double buffering
+uint8_t peekVRAM(uint16_t address);
+void pokeVRAM(uint16_t address, uint8_t value);
+void storeVRAM(uint16_t address, const uint8_t *src, uint8_t len);
+
+template <uint8_t SCREEN_MODE>
+struct Vdp
+{
+    static const uint16_t pattern_table = SCREEN_MODE == VDP_MODE_G1 || SCREEN_MODE == VDP_MODE_MULTICOLOR ? 0x0800 : 0x0000;
+    static const uint16_t name_table = SCREEN_MODE == VDP_MODE_G2 ? 0x3800 : SCREEN_MODE == VDP_MODE_TEXT ? 0x0800 : 0x1400;
+    static const uint16_t pattern_table_size = SCREEN_MODE == VDP_MODE_G2 ? 0x1800 : SCREEN_MODE == VDP_MODE_MULTICOLOR ? 1536 : 0x0800;
+    static const uint16_t color_table = SCREEN_MODE == VDP_MODE_G1 || SCREEN_MODE == VDP_MODE_G2 ? 0x2000 : 0x0000;
+    static const uint16_t color_table_size = SCREEN_MODE == VDP_MODE_G2 ? 0x1800 : SCREEN_MODE == VDP_MODE_G1 ? 32 : 0;
+    static const uint16_t sprite_attribute_table = SCREEN_MODE == VDP_MODE_G1 ? 0x1000 : SCREEN_MODE == VDP_MODE_TEXT ? 0x0000 : 0x3B00;
+    static const uint16_t sprite_pattern_table = SCREEN_MODE == VDP_MODE_G1 || SCREEN_MODE == VDP_MODE_TEXT ? 0x0000 : 0x1800;
+    static const uint8_t columns = SCREEN_MODE == VDP_MODE_TEXT ? 40 : 32;
+    static const uint8_t rows = 24;
+
+    static const bool has_sprites = SCREEN_MODE != VDP_MODE_TEXT;
+    static const bool has_char_colors = SCREEN_MODE == VDP_MODE_G2; // Colors for each character cell
+    static const bool has_pixels = SCREEN_MODE == VDP_MODE_G2 || SCREEN_MODE == VDP_MODE_MULTICOLOR;
+
+    /**
+     * @brief Same as vdp_init(SCREEN_MODE, ...)
+     */
+    static int init(uint8_t fg = VDP_WHITE, uint8_t bg = VDP_BLACK, bool big_sprites = false, bool magnify = false)
+    {
+        return vdp_init(SCREEN_MODE, (fg << 4) | (bg & 0x0F), big_sprites, magnify);
+    }
+
+    /**
+     * @brief Same as vdp_set_mode(SCREEN_MODE, ...)
+     */
+    static int set_mode(uint8_t fg = VDP_WHITE, uint8_t bg = VDP_BLACK, bool big_sprites = false, bool magnify = false)
+    {
+        return vdp_set_mode(SCREEN_MODE, (fg << 4) | (bg & 0x0F), big_sprites, magnify);
+    }
+
+    /**
+     * @brief Position of a character cell in the name table
+     */
+    static uint16_t cell(uint8_t col, uint8_t row) { return row * columns + col; }
+
+    /**
+     * @brief Write a character to a cell. In Graphics Mode 2 its pattern is replaced by the glyph, the colors stay
+     */
+    static void write(uint8_t col, uint8_t row, uint8_t chr)
+    {
+        if (SCREEN_MODE == VDP_MODE_G2)
+        {
+            uint8_t glyph[8];
+            memcpy_P(glyph, vdp_font() + ((chr - 32) << 3), 8);
+            storeVRAM(pattern_table + (cell(col, row) << 3), glyph, 8);
+        }
+        else
+            storeVRAM(name_table + cell(col, row), &chr, 1);
+    }
+
+    /**
+     * @brief Colors of a cell. Graphics Mode 2 only
+     */
+    static void colorize(uint8_t col, uint8_t row, uint8_t fg, uint8_t bg)
+    {
+        if (!has_char_colors)
+            return;
+        uint8_t colors[8];
+        memset(colors, (fg << 4) + bg, 8);
+        storeVRAM(color_table + (cell(col, row) << 3), colors, 8);
+    }
+
+    /**
+     * @brief Set a pixel of 64x48 in Multicolor mode or 64x192 in Graphics Mode 2, see vdp_plot_color()
+     */
+    static void plot_color(uint8_t x, uint8_t y, uint8_t color)
+    {
+        if (!has_pixels)
+            return;
+        uint16_t offset = 8 * (x / 2) + y % 8 + 256 * (y / 8);
+        uint16_t addr = (SCREEN_MODE == VDP_MODE_G2 ? color_table : pattern_table) + offset;
+        uint8_t dot = peekVRAM(addr);
+        if (x & 1) // Odd columns
+            dot = (dot & 0xF0) + (color & 0x0F);
+        else
+            dot = (dot & 0x0F) + (color << 4);
+        if (SCREEN_MODE == VDP_MODE_G2)
+        {
+            uint8_t pattern = 0xF0; // Left half in the foreground color, right half in the background color
+            storeVRAM(pattern_table + offset, &pattern, 1);
+        }
+        pokeVRAM(addr, dot);
+    }
+
+    /**
+     * @brief Colors of a pattern: In Graphics Mode 1 of the group of 8 patterns, in Graphics Mode 2 of one pixel row
+     */
+    static void set_pattern_color(uint16_t index, uint8_t fg, uint8_t bg)
+    {
+        if (SCREEN_MODE == VDP_MODE_G1)
+            index &= 31;
+        else if (SCREEN_MODE != VDP_MODE_G2)
+            return;
+        uint8_t color = (fg << 4) + bg;
+        storeVRAM(color_table + index, &color, 1);
+    }
+};
+
+#endif
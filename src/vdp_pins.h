@@ -0,0 +1,71 @@
+/**
+ * @file vdp_pins.h
+ * @author Doctor Volt
+ * @brief Compile time mapping of the VDP control lines to Arduino pins
+ *
+ * On the ATmega328 (Uno, Nano) the pins are resolved at compile time to single sbi/cbi instructions on their port.
+ * On other platforms, or when VDP_GENERIC_PINS is defined, digitalWrite() is used.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_PINS_H
+#define VDP_PINS_H
+#include "Arduino.h"
+#ifdef VDP_SIM
+#include "vdp_sim.h"
+#endif
+
+#if !defined(VDP_GENERIC_PINS) && (defined(VDP_SIM) || defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168__))
+#define VDP_DIRECT_PINS
+#endif
+
+/**
+ * @brief A control line on Arduino pin PIN
+ */
+template <uint8_t PIN>
+struct VdpPin
+{
+    static const uint8_t pin = PIN;
+
+#if defined(VDP_DIRECT_PINS) && defined(VDP_SIM)
+    static void high()
+    {
+        vdp_sim_cycles(VDP_SIM_CYCLES_SBI);
+        vdp_sim_pin(PIN, HIGH);
+    }
+    static void low()
+    {
+        vdp_sim_cycles(VDP_SIM_CYCLES_SBI);
+        vdp_sim_pin(PIN, LOW);
+    }
+#elif defined(VDP_DIRECT_PINS)
+    // Digital pins 0-7: PORTD, 8-13: PORTB, A0-A5: PORTC
+    static volatile uint8_t &port() { return PIN < 8 ? PORTD : (PIN < 14 ? PORTB : PORTC); }
+    static const uint8_t mask = 1 << (PIN < 8 ? PIN : (PIN < 14 ? PIN - 8 : PIN - 14));
+    static void high() __attribute__((always_inline)) { port() |= mask; }
+    static void low() __attribute__((always_inline)) { port() &= ~mask; }
+#else
+    static void high() { digitalWrite(PIN, HIGH); }
+    static void low() { digitalWrite(PIN, LOW); }
+#endif
+};
+
+/**
+ * @brief Wiring as shown in the schematic
+ */
+struct VdpDefaultPins
+{
+    typedef VdpPin<11> Mode;
+    typedef VdpPin<10> Csw;
+    typedef VdpPin<9> Csr;
+    typedef VdpPin<8> Reset;
+};
+
+/**
+ * @brief INT is not wired in the schematic, the frame flag of the status register is polled instead.
+ * Connect INT to an external interrupt pin (2 or 3 on the Uno and Nano) and define VDP_INT_PIN to detect the frame tick with an interrupt.
+ */
+// #define VDP_INT_PIN 2
+
+#endif
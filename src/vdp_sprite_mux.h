@@ -0,0 +1,182 @@
+/**
+ * @file vdp_sprite_mux.h
+ * @author Doctor Volt
+ * @brief Sprite multiplexer on top of VdpSpriteTable
+ *
+ * The VDP shows only 4 sprites per line and has 32 sprites. The multiplexer manages up to N logical sprites.
+ * On every commit() it sorts them by Y, finds the groups of sprites with more than 4 of them on a line and rotates
+ * the priorities inside these groups, so that a different sprite is dropped in every frame. With more than 32 visible
+ * sprites, a different set of 32 is shown in every frame. Dropped sprites flicker instead of disappearing.
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef VDP_SPRITE_MUX_H
+#define VDP_SPRITE_MUX_H
+#include "tms9918.h"
+
+template <uint8_t N = 64>
+class VdpSpriteMux
+{
+public:
+    VdpSpriteMux()
+    {
+        for (uint8_t i = 0; i < N; i++)
+        {
+            sprites[i].visible = false;
+            sprites[i].name = 0;
+            sprites[i].color = 0;
+            order[i] = i;
+        }
+        frame = 0;
+        crowded_groups = 0;
+    }
+
+    /**
+     * @brief Set the position of a logical sprite and show it. Coordinates as in VdpSpriteTable::set_position()
+     *
+     * @param sprite 0 to N-1
+     * @param x 0-287
+     * @param y
+     */
+    void set_position(uint8_t sprite, uint16_t x, uint8_t y)
+    {
+        if (sprite >= N)
+            return;
+        sprites[sprite].x = x;
+        sprites[sprite].y = y;
+        sprites[sprite].visible = true;
+    }
+
+    void set_color(uint8_t sprite, uint8_t color)
+    {
+        if (sprite < N)
+            sprites[sprite].color = color;
+    }
+
+    /**
+     * @brief Set the pattern of a logical sprite, as in vdp_set_sprite_pattern()
+     */
+    void set_pattern(uint8_t sprite, uint8_t name)
+    {
+        if (sprite < N)
+            sprites[sprite].name = name;
+    }
+
+    void hide(uint8_t sprite)
+    {
+        if (sprite < N)
+            sprites[sprite].visible = false;
+    }
+
+    /**
+     * @brief Number of groups with more than 4 sprites on a line at the last commit()
+     */
+    uint8_t crowded() const
+    {
+        return crowded_groups;
+    }
+
+    /**
+     * @brief Map the logical sprites to the 32 sprites of the VDP and write the sprite attribute table
+     *
+     * @returns Status register as returned by vdp_sprite_write_table()
+     */
+    uint8_t commit()
+    {
+        VDP_API(sprite_mux_commit);
+        sort();
+        uint8_t height = vdp_sprite_height();
+        uint8_t n = 0; // Visible sprites, they are at the start of order
+        while (n < N && sprites[order[n]].visible)
+            n++;
+
+        // More than 32 visible sprites: Show another 32 in every frame, still sorted by Y
+        uint8_t shown[32];
+        uint8_t base = n > 32 ? (uint16_t)frame * 32 % n : 0;
+        if (n > 32)
+        {
+            for (uint8_t s = 0, i = 0; i < n; i++)
+                if ((uint16_t)(i - base + n) % n < 32)
+                    shown[s++] = order[i];
+            n = 32;
+        }
+        else
+            memcpy(shown, order, n);
+
+        // Groups of sprites that overlap in Y. In a group with more than 4 sprites on a line, the priorities are rotated
+        uint8_t slots[32];
+        crowded_groups = 0;
+        for (uint8_t i = 0; i < n;)
+        {
+            uint8_t j = i + 1;
+            bool crowded = false;
+            while (j < n && key(shown[j]) - key(shown[j - 1]) < height)
+            {
+                if (j - i >= 4 && key(shown[j]) - key(shown[j - 4]) < height)
+                    crowded = true;
+                j++;
+            }
+            uint8_t size = j - i;
+            uint8_t r = crowded ? frame % size : 0;
+            for (uint8_t k = 0; k < size; k++)
+                slots[i + k] = shown[i + (k + r) % size];
+            crowded_groups += crowded;
+            i = j;
+        }
+
+        for (uint8_t s = 0; s < 32; s++)
+        {
+            if (s < n)
+            {
+                Logical &l = sprites[slots[s]];
+                table.set_position(s, l.x, l.y);
+                table.set_pattern(s, l.name);
+                table.set_color(s, l.color);
+            }
+            else
+                table.hide(s);
+        }
+        frame++;
+        return table.commit();
+    }
+
+private:
+    struct Logical
+    {
+        uint16_t x;
+        uint8_t y;
+        uint8_t name;
+        uint8_t color;
+        bool visible;
+    } sprites[N];
+    uint8_t order[N]; // Sprite numbers sorted by Y, hidden sprites last. Kept from frame to frame
+    uint8_t frame;
+    uint8_t crowded_groups;
+    VdpSpriteTable table;
+
+    // Y positions above 0xD0 are above the top of the screen
+    int16_t key(uint8_t sprite)
+    {
+        if (!sprites[sprite].visible)
+            return 0x7FFF;
+        uint8_t y = sprites[sprite].y;
+        return y > 0xD0 ? y - 256 : y;
+    }
+
+    // Insertion sort. The order of the last frame is almost right, so this is close to linear
+    void sort()
+    {
+        for (uint8_t i = 1; i < N; i++)
+        {
+            uint8_t sprite = order[i];
+            int16_t k = key(sprite);
+            uint8_t j = i;
+            for (; j > 0 && key(order[j - 1]) > k; j--)
+                order[j] = order[j - 1];
+            order[j] = sprite;
+        }
+    }
+};
+
+#endif